@@ -1,60 +1,85 @@
+#include "activity_detector.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "state.h"
 
 static const char *TAG = "activity_detector";
 extern struct Settings settings;
 
-#define CONFIG_RIDING_CURRENT_LEVEL 0.1
-#define CONFIG_CHARGING_CURRENT_LEVEL -0.1
-#define CONFIG_IDLE_TIME_TO_GO_PARKED 30
+// Start time of a pending transition in ms, 0 when its condition is not met
+int64_t riding_start_time = 0;
+int64_t charging_start_time = 0;
+int64_t idle_start_time = 0;
 
-uint32_t idle_start_time = 0;
+void activity_default_settings(struct ActivitySettings *activity) {
+  activity->riding_current_level = ACTIVITY_DEFAULT_RIDING_CURRENT_LEVEL;
+  activity->charging_current_level = ACTIVITY_DEFAULT_CHARGING_CURRENT_LEVEL;
+  activity->hysteresis = ACTIVITY_DEFAULT_HYSTERESIS;
+  activity->start_time = ACTIVITY_DEFAULT_START_TIME;
+  activity->idle_time = ACTIVITY_DEFAULT_IDLE_TIME;
+  activity->riding_speed_level = ACTIVITY_DEFAULT_RIDING_SPEED_LEVEL;
+}
+
+static bool activity_debounce(int64_t *start_time, bool condition, int64_t now, uint32_t window_ms) {
+  if (!condition) {
+    *start_time = 0;
+    return false;
+  }
+
+  if (*start_time == 0) {
+    *start_time = now;
+  }
+
+  return now - *start_time >= window_ms;
+}
+
+static void activity_set_state(device_state_t new_state) {
+  riding_start_time = 0;
+  charging_start_time = 0;
+  idle_start_time = 0;
+  state_set_device_state(new_state);
+}
 
 void detect_activity(double current) {
-  if (!settings.manual_ride_start) {
-    if (state_get_device_state() == STATE_PARKED) {
-      if (current > CONFIG_RIDING_CURRENT_LEVEL) {
-        ESP_LOGI(TAG, "riding detected");
-        state_set_device_state(STATE_RIDING);
-      } else if (current < CONFIG_CHARGING_CURRENT_LEVEL) {
-        ESP_LOGI(TAG, "charging detected");
-        state_set_device_state(STATE_CHARGING);
-      }
+  if (settings.manual_ride_start) {
+    return;
+  }
+
+  struct ActivitySettings *config = &settings.activity;
+  int32_t current_ma = current * 1000;
+  int64_t now = esp_timer_get_time() / 1000;
+
+  int32_t riding_exit_level = config->riding_current_level - config->hysteresis;
+  int32_t charging_exit_level = config->charging_current_level - config->hysteresis;
+
+  switch (state_get_device_state()) {
+  case STATE_PARKED:
+    if (activity_debounce(&riding_start_time, current_ma > config->riding_current_level, now, config->start_time)) {
+      ESP_LOGI(TAG, "riding detected");
+      activity_set_state(STATE_RIDING);
+    } else if (activity_debounce(&charging_start_time, current_ma < -config->charging_current_level, now,
+                                 config->start_time)) {
+      ESP_LOGI(TAG, "charging detected");
+      activity_set_state(STATE_CHARGING);
     }
+    break;
+
+  case STATE_RIDING: {
+    // regenerative braking and rolling without throttle still count as riding
+    bool is_moving = state_get()->gps_fix_status > 0 && state_get()->speed.value >= config->riding_speed_level;
+    bool is_active = current_ma > riding_exit_level || current_ma < -charging_exit_level || is_moving;
 
-    if (state_get_device_state() == STATE_CHARGING) {
-      if (current > CONFIG_CHARGING_CURRENT_LEVEL) {
-
-        if (idle_start_time == 0) {
-          idle_start_time = xTaskGetTickCount();
-        } else {
-          ESP_LOGI(TAG, "idle detected %d", xTaskGetTickCount() - idle_start_time);
-          if ((xTaskGetTickCount() - idle_start_time) > CONFIG_IDLE_TIME_TO_GO_PARKED * 1000) {
-            ESP_LOGI(TAG, "charging finished");
-            state_set_device_state(STATE_PARKED);
-            idle_start_time = 0;
-          }
-        }
-      } else {
-        idle_start_time = 0;
-      }
+    if (activity_debounce(&idle_start_time, !is_active, now, config->idle_time * 1000)) {
+      ESP_LOGI(TAG, "riding finished");
+      activity_set_state(STATE_PARKED);
     }
+  } break;
 
-    if (state_get_device_state() == STATE_RIDING) {
-      if (current < CONFIG_RIDING_CURRENT_LEVEL && current > CONFIG_CHARGING_CURRENT_LEVEL) {
-
-        if (idle_start_time == 0) {
-          idle_start_time = xTaskGetTickCount();
-        } else {
-          ESP_LOGI(TAG, "idle detected %d", xTaskGetTickCount() - idle_start_time);
-          if ((xTaskGetTickCount() - idle_start_time) > CONFIG_IDLE_TIME_TO_GO_PARKED * 1000) {
-            state_set_device_state(STATE_PARKED);
-            idle_start_time = 0;
-          }
-        }
-      } else {
-        idle_start_time = 0;
-      }
+  case STATE_CHARGING:
+    if (activity_debounce(&idle_start_time, current_ma > -charging_exit_level, now, config->idle_time * 1000)) {
+      ESP_LOGI(TAG, "charging finished");
+      activity_set_state(STATE_PARKED);
     }
+    break;
   }
-}
\ No newline at end of file
+}
@@ -1,6 +1,16 @@
 #ifndef activity_detector_h
 #define activity_detector_h
 
+#include "state.h"
+
+#define ACTIVITY_DEFAULT_RIDING_CURRENT_LEVEL 100
+#define ACTIVITY_DEFAULT_CHARGING_CURRENT_LEVEL 100
+#define ACTIVITY_DEFAULT_HYSTERESIS 50
+#define ACTIVITY_DEFAULT_START_TIME 1000
+#define ACTIVITY_DEFAULT_IDLE_TIME 30
+#define ACTIVITY_DEFAULT_RIDING_SPEED_LEVEL 5
+
+void activity_default_settings(struct ActivitySettings *activity);
 void detect_activity(double current);
 
 #endif
\ No newline at end of file
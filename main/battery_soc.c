@@ -0,0 +1,62 @@
+#include "battery_soc.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "service_battery.h"
+#include "soc_estimator.h"
+#include "state.h"
+
+static const char *TAG = "soc";
+
+#define SOC_MIN_TRIP_DISTANCE_KM 0.5
+
+static struct SocEstimator estimator = {
+    .cells = SOC_DEFAULT_CELL_COUNT,
+    .capacity_mas = SOC_DEFAULT_CAPACITY_MAH * SOC_MAS_PER_MAH,
+};
+
+// Updated from the ADC task, the main task while parked and the BLE settings handler
+static portMUX_TYPE soc_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void soc_init(uint8_t cell_count, uint16_t capacity_mah) {
+  portENTER_CRITICAL(&soc_lock);
+  soc_estimator_init(&estimator, cell_count > 0 ? cell_count : SOC_DEFAULT_CELL_COUNT,
+                     capacity_mah > 0 ? capacity_mah : SOC_DEFAULT_CAPACITY_MAH);
+  portEXIT_CRITICAL(&soc_lock);
+
+  ESP_LOGI(TAG, "pack %dS %d mAh", cell_count, capacity_mah);
+}
+
+void soc_update(int32_t voltage_mv, int32_t current_ma) {
+  int64_t now = esp_timer_get_time();
+
+  portENTER_CRITICAL(&soc_lock);
+  soc_estimator_update(&estimator, voltage_mv, current_ma, now);
+  portEXIT_CRITICAL(&soc_lock);
+}
+
+uint16_t soc_get_permille() {
+  portENTER_CRITICAL(&soc_lock);
+  uint16_t permille = soc_estimator_get_permille(&estimator);
+  portEXIT_CRITICAL(&soc_lock);
+  return permille;
+}
+
+uint32_t soc_get_remaining_mah() {
+  portENTER_CRITICAL(&soc_lock);
+  uint32_t remaining = soc_estimator_get_remaining_mah(&estimator);
+  portEXIT_CRITICAL(&soc_lock);
+  return remaining;
+}
+
+void soc_publish() {
+  struct CurrentState *state = state_get();
+  double consumption = SOC_DEFAULT_CONSUMPTION_MAH_PER_KM;
+
+  if (state->trip_distance.value > SOC_MIN_TRIP_DISTANCE_KM && state->used_energy.value > 0) {
+    consumption = state->used_energy.value * 1000 / state->trip_distance.value;
+  }
+
+  battery_update_value(soc_get_permille() / 10.0, IDX_CHAR_VAL_SOC, false);
+  battery_update_value(soc_get_remaining_mah() / consumption, IDX_CHAR_VAL_RANGE, false);
+}
@@ -0,0 +1,17 @@
+#ifndef battery_soc_h
+#define battery_soc_h
+
+#include <stdint.h>
+
+#define SOC_DEFAULT_CELL_COUNT 10
+#define SOC_DEFAULT_CAPACITY_MAH 10000
+#define SOC_DEFAULT_CONSUMPTION_MAH_PER_KM 350
+
+void soc_init(uint8_t cell_count, uint16_t capacity_mah);
+void soc_update(int32_t voltage_mv, int32_t current_ma);
+void soc_publish();
+
+uint16_t soc_get_permille();
+uint32_t soc_get_remaining_mah();
+
+#endif
@@ -0,0 +1,118 @@
+#include "current_calibration.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "calibration";
+
+#define KEY_CALIBRATION "current_cal"
+
+#define CALIBRATION_INTERVAL_US (10 * 60 * 1000 * 1000LL)
+#define CALIBRATION_RETRY_INTERVAL_US (60 * 1000 * 1000LL)
+#define CALIBRATION_FORGET_FACTOR 0.9
+#define CALIBRATION_MIN_TEMPERATURE_SPREAD 3.0
+#define CALIBRATION_SAVE_THRESHOLD 0.0005
+
+// Exponentially weighted least squares of sensor zero against temperature
+struct CalibrationModel {
+  double weight;
+  double sum_t;
+  double sum_z;
+  double sum_tt;
+  double sum_tz;
+};
+
+static struct CalibrationModel model;
+static double saved_zero = CALIBRATION_DEFAULT_ZERO;
+static int64_t last_calibration_time = 0;
+static int64_t last_attempt_time = 0;
+
+static void calibration_save() {
+  nvs_handle_t my_handle;
+  esp_err_t err = nvs_open("storage", NVS_READWRITE, &my_handle);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Error (%s) opening NVS handle!\n", esp_err_to_name(err));
+    return;
+  }
+
+  nvs_set_blob(my_handle, KEY_CALIBRATION, &model, sizeof(model));
+
+  err = nvs_commit(my_handle);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to save calibration");
+  }
+  nvs_close(my_handle);
+}
+
+void calibration_init() {
+  nvs_handle_t my_handle;
+  esp_err_t err = nvs_open("storage", NVS_READWRITE, &my_handle);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Error (%s) opening NVS handle!\n", esp_err_to_name(err));
+    return;
+  }
+
+  size_t len = sizeof(model);
+  if (nvs_get_blob(my_handle, KEY_CALIBRATION, &model, &len) != ESP_OK || len != sizeof(model)) {
+    memset(&model, 0, sizeof(model));
+  }
+  nvs_close(my_handle);
+
+  if (model.weight > 0) {
+    saved_zero = model.sum_z / model.weight;
+  }
+  ESP_LOGI(TAG, "loaded zero %f", saved_zero);
+}
+
+// Counts as an attempt, a calibration rejected because the sensor wasn't idle is retried after
+// CALIBRATION_RETRY_INTERVAL_US instead of on every parked wake up
+bool calibration_is_due() {
+  int64_t now = esp_timer_get_time();
+
+  if (last_attempt_time != 0 && now - last_attempt_time < CALIBRATION_RETRY_INTERVAL_US) {
+    return false;
+  }
+  if (last_calibration_time != 0 && now - last_calibration_time <= CALIBRATION_INTERVAL_US) {
+    return false;
+  }
+
+  last_attempt_time = now;
+  return true;
+}
+
+void calibration_add_measurement(double zero, float temperature) {
+  last_calibration_time = esp_timer_get_time();
+
+  model.weight = model.weight * CALIBRATION_FORGET_FACTOR + 1;
+  model.sum_t = model.sum_t * CALIBRATION_FORGET_FACTOR + temperature;
+  model.sum_z = model.sum_z * CALIBRATION_FORGET_FACTOR + zero;
+  model.sum_tt = model.sum_tt * CALIBRATION_FORGET_FACTOR + temperature * temperature;
+  model.sum_tz = model.sum_tz * CALIBRATION_FORGET_FACTOR + temperature * zero;
+
+  double current_zero = calibration_get_zero(temperature);
+  ESP_LOGI(TAG, "measured zero %f at %.2fC, model %f", zero, temperature, current_zero);
+
+  if (fabs(current_zero - saved_zero) > CALIBRATION_SAVE_THRESHOLD) {
+    saved_zero = current_zero;
+    calibration_save();
+  }
+}
+
+double calibration_get_zero(float temperature) {
+  if (model.weight <= 0) {
+    return CALIBRATION_DEFAULT_ZERO;
+  }
+
+  double mean_t = model.sum_t / model.weight;
+  double mean_z = model.sum_z / model.weight;
+  double var_t = model.sum_tt / model.weight - mean_t * mean_t;
+
+  if (var_t < CALIBRATION_MIN_TEMPERATURE_SPREAD * CALIBRATION_MIN_TEMPERATURE_SPREAD) {
+    return mean_z;
+  }
+
+  double slope = (model.sum_tz / model.weight - mean_t * mean_z) / var_t;
+  return mean_z + slope * (temperature - mean_t);
+}
@@ -0,0 +1,14 @@
+#ifndef current_calibration_h
+#define current_calibration_h
+
+#include <stdbool.h>
+
+#define CALIBRATION_DEFAULT_ZERO 1.622531
+#define CALIBRATION_NUM_SAMPLES 64
+
+void calibration_init();
+bool calibration_is_due();
+void calibration_add_measurement(double zero, float temperature);
+double calibration_get_zero(float temperature);
+
+#endif
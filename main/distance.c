@@ -0,0 +1,16 @@
+#include "distance.h"
+#include "odometer.h"
+#include "service_location.h"
+#include "state.h"
+
+static struct Odometer odometer = {0};
+
+void distance_reset() { odometer_reset(&odometer); }
+
+void distance_add_fix(double latitude, double longitude, double speed) {
+  double chunk = odometer_add_fix(&odometer, latitude, longitude, speed);
+
+  if (chunk > 0) {
+    location_update_value(state_get()->trip_distance.value + chunk, IDX_CHAR_VAL_TRIP_DISTANCE, false);
+  }
+}
@@ -0,0 +1,7 @@
+#ifndef distance_h
+#define distance_h
+
+void distance_reset();
+void distance_add_fix(double latitude, double longitude, double speed);
+
+#endif
@@ -111,3 +111,16 @@ esp_err_t ds3231_get_time(struct tm *time) {
 
   return ESP_OK;
 }
+
+esp_err_t ds3231_get_temp_float(float *temp) {
+  uint8_t data[2];
+
+  esp_err_t res = i2c_dev_read_reg(DS3231_ADDR_TEMP, data, 2);
+  if (res != ESP_OK)
+    return res;
+
+  /* signed integer part followed by fraction in upper two bits, 0.25 deg resolution */
+  *temp = (int8_t)data[0] + (data[1] >> 6) * 0.25f;
+
+  return ESP_OK;
+}
@@ -37,5 +37,6 @@
 
 esp_err_t ds3231_set_time(struct tm *time);
 esp_err_t ds3231_get_time(struct tm *time);
+esp_err_t ds3231_get_temp_float(float *temp);
 
 #endif
\ No newline at end of file
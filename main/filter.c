@@ -0,0 +1,70 @@
+#include "filter.h"
+#include <string.h>
+#include <sys/param.h>
+
+#define LOW_PASS_FRACTION_BITS 8
+
+void filter_moving_average_init(struct MovingAverageFilter *filter, uint8_t size) {
+  memset(filter, 0, sizeof(struct MovingAverageFilter));
+  filter->size = size > FILTER_MOVING_AVERAGE_MAX_SIZE ? FILTER_MOVING_AVERAGE_MAX_SIZE : MAX(size, 1);
+}
+
+int32_t filter_moving_average_update(struct MovingAverageFilter *filter, int32_t sample) {
+  filter->sum += sample - filter->buffer[filter->index];
+  filter->buffer[filter->index] = sample;
+  filter->index = (filter->index + 1) % filter->size;
+
+  if (filter->count < filter->size) {
+    filter->count++;
+  }
+
+  return filter->sum / filter->count;
+}
+
+void filter_low_pass_init(struct LowPassFilter *filter, uint8_t shift) {
+  filter->state = 0;
+  filter->shift = shift;
+  filter->is_initialized = false;
+}
+
+int32_t filter_low_pass_update(struct LowPassFilter *filter, int32_t sample) {
+  // a left shift of a negative sample is undefined, the multiplication compiles to the same shift
+  int32_t scaled = sample * (1 << LOW_PASS_FRACTION_BITS);
+
+  if (!filter->is_initialized) {
+    filter->state = scaled;
+    filter->is_initialized = true;
+  } else {
+    filter->state += (scaled - filter->state) >> filter->shift;
+  }
+
+  return filter->state >> LOW_PASS_FRACTION_BITS;
+}
+
+void filter_median_init(struct MedianFilter *filter, uint8_t size) {
+  memset(filter, 0, sizeof(struct MedianFilter));
+  filter->size = size > FILTER_MEDIAN_MAX_SIZE ? FILTER_MEDIAN_MAX_SIZE : MAX(size, 1);
+}
+
+int32_t filter_median_update(struct MedianFilter *filter, int32_t sample) {
+  int32_t sorted[FILTER_MEDIAN_MAX_SIZE];
+
+  filter->buffer[filter->index] = sample;
+  filter->index = (filter->index + 1) % filter->size;
+
+  if (filter->count < filter->size) {
+    filter->count++;
+  }
+
+  for (uint8_t i = 0; i < filter->count; i++) {
+    int32_t value = filter->buffer[i];
+    int8_t j = i - 1;
+    while (j >= 0 && sorted[j] > value) {
+      sorted[j + 1] = sorted[j];
+      j--;
+    }
+    sorted[j + 1] = value;
+  }
+
+  return sorted[filter->count / 2];
+}
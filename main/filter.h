@@ -0,0 +1,41 @@
+#ifndef filter_h
+#define filter_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FILTER_MOVING_AVERAGE_MAX_SIZE 16
+#define FILTER_MEDIAN_MAX_SIZE 7
+
+struct MovingAverageFilter {
+  int32_t buffer[FILTER_MOVING_AVERAGE_MAX_SIZE];
+  int32_t sum;
+  uint8_t size;
+  uint8_t index;
+  uint8_t count;
+};
+
+// Single pole low-pass, y += (x - y) >> shift, state kept with 8 extra fractional bits
+struct LowPassFilter {
+  int32_t state;
+  uint8_t shift;
+  bool is_initialized;
+};
+
+struct MedianFilter {
+  int32_t buffer[FILTER_MEDIAN_MAX_SIZE];
+  uint8_t size;
+  uint8_t index;
+  uint8_t count;
+};
+
+void filter_moving_average_init(struct MovingAverageFilter *filter, uint8_t size);
+int32_t filter_moving_average_update(struct MovingAverageFilter *filter, int32_t sample);
+
+void filter_low_pass_init(struct LowPassFilter *filter, uint8_t shift);
+int32_t filter_low_pass_update(struct LowPassFilter *filter, int32_t sample);
+
+void filter_median_init(struct MedianFilter *filter, uint8_t size);
+int32_t filter_median_update(struct MedianFilter *filter, int32_t sample);
+
+#endif
@@ -1,5 +1,10 @@
 #include "driver/gpio.h"
 #include "driver/uart.h"
+#include "distance.h"
+#include "esp_timer.h"
+#include "kalman.h"
+#include "nmea.h"
+#include "telemetry.h"
 #include "esp_log.h"
 #include "esp_system.h"
 #include "freertos/FreeRTOS.h"
@@ -7,12 +12,16 @@
 #include "service_location.h"
 #include "state.h"
 #include "string.h"
+#include <stdlib.h>
 
 #include "esp32/pm.h"
 #include "esp_pm.h"
 
 static const int RX_BUF_SIZE = 1024;
 
+#define GPS_ESTIMATE_INTERVAL_MS 200
+#define GPS_LINE_MAX 128
+
 #define TXD_PIN (GPIO_NUM_17)
 #define RXD_PIN (GPIO_NUM_16)
 
@@ -34,147 +43,111 @@ void gps_init_uart() {
   uart_driver_install(UART_NUM_2, RX_BUF_SIZE * 2, 0, 0, NULL, 0);
 }
 
-bool gps_is_location_valid(uint8_t *data) {
-  char *end_line_index = strchr((char *)data, 0x0D);
-  char *is_data_correct_marker = strstr((char *)data, ",A,");
-  return is_data_correct_marker != NULL && is_data_correct_marker < end_line_index;
-}
-
-void gps_get_location(uint8_t *data) {
-  if (data == NULL) {
-    return;
-  }
-  char substr[12];
-
-  double lat = 0;
-  double lon = 0;
-  char lat_ind, lon_ind;
-
-  if (gps_is_location_valid(data)) {
-    char *start = strchr((char *)data, ',') + 1;
-    strncpy(substr, start, 2);
-    substr[2] = 0;
-    lat = atoi(substr);
-
-    strncpy(substr, start + 2, 7);
-    substr[7] = 0;
-    lat = lat + atof(substr) / 60;
-
-    start = strchr((char *)start, ',') + 1;
-    strncpy(substr, start, 1);
-    substr[1] = 0;
-    lat_ind = substr[0];
-
-    start = strchr((char *)start, ',') + 1;
-    strncpy(substr, start, 3);
-    substr[3] = 0;
-    lon = atoi(substr);
-
-    strncpy(substr, start + 3, 7);
-    substr[7] = 0;
-    lon = lon + atof(substr) / 60;
-
-    start = strchr((char *)start, ',') + 1;
-    strncpy(substr, start, 1);
-    substr[1] = 0;
-    lon_ind = substr[0];
-
-    if (lat_ind == 'S') {
-      lat = -lat;
-    }
-
-    if (lon_ind == 'W') {
-      lon = -lon;
-    }
-    location_update_value(lat, IDX_CHAR_VAL_LATITUDE, false);
-    location_update_value(lon, IDX_CHAR_VAL_LONGITUDE, false);
-  }
-}
+// $GNGGA carries fix quality, satelites in use and altitude
+static void gps_satelite_info(const char *sentence) {
+  uint8_t fix, satelite_number = 0;
 
-void gps_get_speed(uint8_t *data) {
-  if (data == NULL) {
+  if (!nmea_get_satelite_info(sentence, &fix, &satelite_number, &state.altitude.value)) {
     return;
   }
-  char substr[12];
-
-  char *start = strstr((char *)data, "N,");
-  double speed = 0;
-
-  if (start != NULL) {
-    start = start + 2;
-    char *end = strchr((char *)start, ',');
 
-    mempcpy(substr, start, end - start);
-    substr[end - start] = 0;
-    speed = atof(substr);
-    location_update_value(speed, IDX_CHAR_VAL_SPEED, false);
-  }
+  location_update_u8_value(satelite_number, IDX_CHAR_VAL_GPS_SATELITE_COUNT, false);
+  location_update_u8_value(fix, IDX_CHAR_VAL_GPS_FIX, false);
 }
 
-void gps_satelite_info(uint8_t *data) {
-  if (data == NULL) {
-    return;
-  }
+// Once the filter stops predicting, speed and fix status are cleared a single time so nothing keeps using the last
+// extrapolated values; the position stays at the last estimate
+static bool has_estimate = false;
 
-  char substr[12];
-  char *start = strchr((char *)data, ',') + 1;
+bool gps_publish_estimate() {
+  struct KalmanEstimate estimate;
 
-  if (start != NULL) {
-    for (uint8_t i = 0; i < 5; i++) {
-      start = strchr((char *)start, ',') + 1;
+  if (!kalman_get_estimate(esp_timer_get_time(), &estimate)) {
+    if (has_estimate) {
+      has_estimate = false;
+      ESP_LOGI(RX_TASK_TAG, "fix lost");
+      location_update_value(0, IDX_CHAR_VAL_SPEED, false);
+      location_update_u8_value(0, IDX_CHAR_VAL_GPS_FIX, false);
     }
+    return false;
+  }
+  has_estimate = true;
 
-    char *end = strchr((char *)start, ',');
-
-    mempcpy(substr, start, end - start);
-    substr[end - start] = 0;
-
-    uint8_t fix = atoi(substr);
-
-    start = end + 1;
-    end = strchr((char *)start, ',');
-
-    mempcpy(substr, start, end - start);
-    substr[end - start] = 0;
-
-    uint8_t satelite_number = atoi(substr);
-
-    start = end + 1;
-    end = strchr((char *)start, ',');
+  location_update_value(estimate.latitude, IDX_CHAR_VAL_LATITUDE, false);
+  location_update_value(estimate.longitude, IDX_CHAR_VAL_LONGITUDE, false);
+  location_update_value(estimate.speed, IDX_CHAR_VAL_SPEED, false);
+  location_update_value(estimate.heading, IDX_CHAR_VAL_HEADING, false);
+  return true;
+}
 
-    start = end + 1;
-    end = strchr((char *)start, ',');
-    mempcpy(substr, start, end - start);
-    substr[end - start] = 0;
+// Last course reported while moving, VTG leaves it empty at standstill and 0 would mean north
+static double last_course = 0;
+static double last_speed = 0;
 
-    state.altitude.value = atof(substr);
-    ;
+// Handles one complete sentence, returns true when it carried a new position
+static bool gps_handle_nmea_sentence(const char *sentence, int64_t now) {
+  double latitude, longitude;
 
-    location_update_u8_value(satelite_number, IDX_CHAR_VAL_GPS_SATELITE_COUNT, false);
-    location_update_u8_value(fix, IDX_CHAR_VAL_GPS_FIX, false);
+  if (!nmea_is_checksum_valid(sentence)) {
+    return false;
   }
-}
 
-void gps_handle_nmea_data(uint8_t *data, uint16_t len) {
-  gps_get_location((uint8_t *)strstr((char *)data, "$GNGLL"));
-  gps_get_speed((uint8_t *)strstr((char *)data, "$GNVTG"));
-  gps_satelite_info((uint8_t *)strstr((char *)data, "$GNGGA"));
+  if (strncmp(sentence, "$GNGLL", 6) == 0) {
+    if (nmea_get_location(sentence, &latitude, &longitude)) {
+      kalman_update_position(latitude, longitude, now);
+      telemetry_add_gps(now, latitude, longitude, last_speed, last_course);
+      return true;
+    }
+  } else if (strncmp(sentence, "$GNVTG", 6) == 0) {
+    if (nmea_get_speed(sentence, &last_speed, &last_course)) {
+      kalman_update_velocity(last_speed, last_course, now);
+    }
+  } else if (strncmp(sentence, "$GNGGA", 6) == 0) {
+    gps_satelite_info(sentence);
+  }
+  return false;
 }
 
 void gps_rx_task() {
   esp_log_level_set(RX_TASK_TAG, ESP_LOG_INFO);
-  uint8_t *data = (uint8_t *)malloc(RX_BUF_SIZE + 1);
+  uint8_t *data = (uint8_t *)malloc(RX_BUF_SIZE);
+
+  // sentences regularly straddle two reads, they are only parsed once the whole line is in
+  static char line[GPS_LINE_MAX];
+  size_t line_length = 0;
 
   while (1) {
     while (!state_is_in_driving_state()) {
       vTaskDelay(1000 / portTICK_PERIOD_MS);
+      kalman_reset();
+      line_length = 0;
+    }
+
+    const int rxBytes = uart_read_bytes(UART_NUM_2, data, RX_BUF_SIZE, GPS_ESTIMATE_INTERVAL_MS / portTICK_RATE_MS);
+    if (rxBytes <= 0) {
+      gps_publish_estimate();
+      continue;
+    }
+
+    int64_t now = esp_timer_get_time();
+    bool has_new_location = false;
+
+    for (int i = 0; i < rxBytes; i++) {
+      char c = data[i];
+      if (c == '$') {
+        line_length = 0;
+      }
+      if (c == '\n') {
+        line[line_length] = 0;
+        has_new_location |= gps_handle_nmea_sentence(line, now);
+        line_length = 0;
+      } else if (line_length < sizeof(line) - 1) {
+        line[line_length++] = c;
+      }
     }
 
-    const int rxBytes = uart_read_bytes(UART_NUM_2, data, RX_BUF_SIZE, 500 / portTICK_RATE_MS);
-    if (rxBytes > 0) {
-      data[rxBytes] = 0;
-      // ESP_LOGI("As", "%s", data);
-      gps_handle_nmea_data(data, rxBytes);
+    if (gps_publish_estimate() && has_new_location) {
+      distance_add_fix(state.latitude.value, state.longitude.value, state.speed.value);
     }
   }
   free(data);
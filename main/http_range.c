@@ -0,0 +1,33 @@
+#include "http_range.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Parses a single "bytes=first-last", "bytes=first-" or "bytes=-suffix" range,
+ * returns false when the range can't be satisfied */
+bool http_parse_range(const char *range, size_t size, size_t *first, size_t *last) {
+  if (strncmp(range, "bytes=", 6) != 0 || size == 0) {
+    return false;
+  }
+  range += 6;
+
+  char *end;
+  if (*range == '-') {
+    size_t suffix = strtoul(range + 1, &end, 10);
+    if (suffix == 0) {
+      return false;
+    }
+    *first = suffix < size ? size - suffix : 0;
+    *last = size - 1;
+    return true;
+  }
+
+  *first = strtoul(range, &end, 10);
+  if (*end != '-' || *first >= size) {
+    return false;
+  }
+  *last = end[1] != 0 ? strtoul(end + 1, NULL, 10) : size - 1;
+  if (*last >= size) {
+    *last = size - 1;
+  }
+  return *first <= *last;
+}
@@ -0,0 +1,9 @@
+#ifndef http_range_h
+#define http_range_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+bool http_parse_range(const char *range, size_t size, size_t *first, size_t *last);
+
+#endif
@@ -1,5 +1,6 @@
 #include <dirent.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/param.h>
 #include <sys/stat.h>
@@ -7,26 +8,47 @@
 
 #include "esp_err.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
 
 #include "esp_http_server.h"
 #include "esp_spiffs.h"
 #include "esp_vfs.h"
 
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#include "http_range.h"
+#include "json_writer.h"
+#include "log_export.h"
+#include "live_stream.h"
+#include "ride_index.h"
+#include "ride_summary.h"
+#include "state.h"
+#include "storage_space.h"
+#include "telemetry.h"
+
+extern struct Settings settings;
+extern struct TelemetryStats telemetry_stats;
+
 const char *HTTP_TAG = "HttpServer";
 
-/* Scratch buffer size */
-#define SCRATCH_BUFSIZE 8192
+/* Size and number of transfer buffers, each request being served holds one */
+#define HTTP_BUFFER_SIZE 4096
+#define HTTP_BUFFER_COUNT 3
+#define HTTP_BUFFER_WAIT_MS 1000
 
 struct file_server_data {
   /* Base path of file storage */
   char base_path[ESP_VFS_PATH_MAX + 1];
 
-  /* Scratch buffer for temporary storage during file transfer */
-  char scratch[SCRATCH_BUFSIZE];
+  /* Pool of free transfer buffers */
+  QueueHandle_t buffers;
 };
 
 struct file_server_data server_data;
-#define FILE_PATH_MAX 50
+static httpd_handle_t server = NULL;
+#define FILE_PATH_MAX 80
 
 /* Copies the full path into destination buffer and returns
  * pointer to path (skipping the preceding base path) */
@@ -141,13 +163,84 @@ static esp_err_t index_html_get_handler(httpd_req_t *req) {
   return ESP_OK;
 }
 
+static const char *http_content_type(const char *filename) {
+  const char *extension = strrchr(filename, '.');
+
+  if (extension == NULL) {
+    return "application/octet-stream";
+  }
+  if (strcmp(extension, ".log") == 0 || strcmp(extension, ".csv") == 0) {
+    return "text/csv";
+  }
+  if (strcmp(extension, ".html") == 0) {
+    return "text/html";
+  }
+  if (strcmp(extension, ".json") == 0) {
+    return "application/json";
+  }
+  if (strcmp(extension, ".txt") == 0) {
+    return "text/plain";
+  }
+  return "application/octet-stream";
+}
+
+/* Binary logs are converted while streaming, ?format=jsonl selects JSON lines instead of csv.
+ * The converted length is unknown up front so ranges are not offered */
+static esp_err_t http_send_log_export(httpd_req_t *req, struct file_server_data *server, struct LogExport *export,
+                                      struct stat *file_stat) {
+  char etag[32];
+  char header[64];
+  const char *suffix = export->format == LOG_EXPORT_JSON_LINES ? "jsonl" : "csv";
+
+  snprintf(etag, sizeof(etag), "\"%lx-%lx-%s\"", (unsigned long)file_stat->st_size, (unsigned long)file_stat->st_mtime,
+           suffix);
+  httpd_resp_set_hdr(req, "ETag", etag);
+  httpd_resp_set_hdr(req, "Accept-Ranges", "none");
+  httpd_resp_set_type(req, export->format == LOG_EXPORT_JSON_LINES ? "application/x-ndjson" : "text/csv");
+
+  if (httpd_req_get_hdr_value_str(req, "If-None-Match", header, sizeof(header)) == ESP_OK &&
+      strcmp(header, etag) == 0) {
+    log_export_close(export);
+    httpd_resp_set_status(req, "304 Not Modified");
+    return httpd_resp_send(req, NULL, 0);
+  }
+
+  /* Conversion reuses a pooled transfer buffer, memory use does not depend on the log size */
+  char *chunk;
+  if (xQueueReceive(server->buffers, &chunk, HTTP_BUFFER_WAIT_MS / portTICK_PERIOD_MS) != pdTRUE) {
+    log_export_close(export);
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    return httpd_resp_send(req, NULL, 0);
+  }
+
+  size_t length;
+  esp_err_t ret = ESP_OK;
+  while ((length = log_export_read(export, chunk, HTTP_BUFFER_SIZE)) > 0) {
+    if (httpd_resp_send_chunk(req, chunk, length) != ESP_OK) {
+      ESP_LOGE(HTTP_TAG, "Log export failed!");
+      ret = ESP_FAIL;
+      break;
+    }
+  }
+
+  log_export_close(export);
+  xQueueSend(server->buffers, &chunk, 0);
+
+  if (ret != ESP_OK) {
+    httpd_resp_sendstr_chunk(req, NULL);
+    return ESP_FAIL;
+  }
+  httpd_resp_send_chunk(req, NULL, 0);
+  return ESP_OK;
+}
+
 static esp_err_t download_get_handler(httpd_req_t *req) {
   char filepath[FILE_PATH_MAX];
   FILE *fd = NULL;
   struct stat file_stat;
+  struct file_server_data *server = (struct file_server_data *)req->user_ctx;
 
-  const char *filename =
-      get_path_from_uri(filepath, ((struct file_server_data *)req->user_ctx)->base_path, req->uri, sizeof(filepath));
+  const char *filename = get_path_from_uri(filepath, server->base_path, req->uri, sizeof(filepath));
 
   ESP_LOGE(HTTP_TAG, "get %s", filename);
   if (!filename) {
@@ -174,40 +267,103 @@ static esp_err_t download_get_handler(httpd_req_t *req) {
     return ESP_FAIL;
   }
 
+  const char *extension = strrchr(filename, '.');
+  if (extension != NULL && strcmp(extension, ".log") == 0) {
+    char query[32];
+    char format[8] = "";
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+      httpd_query_key_value(query, "format", format, sizeof(format));
+    }
+
+    struct LogExport export;
+    if (log_export_open(&export, filepath, strcmp(format, "jsonl") == 0 ? LOG_EXPORT_JSON_LINES : LOG_EXPORT_CSV)) {
+      if (export.is_binary) {
+        return http_send_log_export(req, server, &export, &file_stat);
+      }
+      log_export_close(&export);
+    }
+  }
+
+  /* Size and modification time change whenever a log grows, which is all the validator has to catch */
+  char etag[24];
+  char header[64];
+  snprintf(etag, sizeof(etag), "\"%lx-%lx\"", (unsigned long)file_stat.st_size, (unsigned long)file_stat.st_mtime);
+  httpd_resp_set_hdr(req, "ETag", etag);
+  httpd_resp_set_hdr(req, "Accept-Ranges", "bytes");
+  httpd_resp_set_type(req, http_content_type(filename));
+
+  if (httpd_req_get_hdr_value_str(req, "If-None-Match", header, sizeof(header)) == ESP_OK &&
+      strcmp(header, etag) == 0) {
+    httpd_resp_set_status(req, "304 Not Modified");
+    return httpd_resp_send(req, NULL, 0);
+  }
+
+  size_t first = 0;
+  size_t last = file_stat.st_size > 0 ? file_stat.st_size - 1 : 0;
+  char content_range[48];
+
+  if (httpd_req_get_hdr_value_str(req, "Range", header, sizeof(header)) == ESP_OK) {
+    if (!http_parse_range(header, file_stat.st_size, &first, &last)) {
+      snprintf(content_range, sizeof(content_range), "bytes */%ld", file_stat.st_size);
+      httpd_resp_set_hdr(req, "Content-Range", content_range);
+      httpd_resp_set_status(req, "416 Range Not Satisfiable");
+      return httpd_resp_send(req, NULL, 0);
+    }
+    snprintf(content_range, sizeof(content_range), "bytes %d-%d/%ld", first, last, file_stat.st_size);
+    httpd_resp_set_hdr(req, "Content-Range", content_range);
+    httpd_resp_set_status(req, "206 Partial Content");
+  }
+
   fd = fopen(filepath, "r");
-  if (!fd) {
+  if (!fd || fseek(fd, first, SEEK_SET) != 0) {
+    if (fd) {
+      fclose(fd);
+    }
     ESP_LOGE(HTTP_TAG, "Failed to read existing file : %s", filepath);
     /* Respond with 500 Internal Server Error */
     httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to read existing file");
     return ESP_FAIL;
   }
 
-  ESP_LOGI(HTTP_TAG, "Sending file : %s (%ld bytes)...", filename, file_stat.st_size);
-  httpd_resp_set_type(req, "text/plain");
+  /* Take a transfer buffer from the pool, concurrent downloads never share one */
+  char *chunk;
+  if (xQueueReceive(server->buffers, &chunk, HTTP_BUFFER_WAIT_MS / portTICK_PERIOD_MS) != pdTRUE) {
+    fclose(fd);
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    return httpd_resp_send(req, NULL, 0);
+  }
+
+  ESP_LOGI(HTTP_TAG, "Sending file : %s (%d-%d of %ld bytes)...", filename, first, last, file_stat.st_size);
 
-  /* Retrieve the pointer to scratch buffer for temporary storage */
-  char *chunk = ((struct file_server_data *)req->user_ctx)->scratch;
-  size_t chunksize;
-  do {
-    /* Read file in chunks into the scratch buffer */
-    chunksize = fread(chunk, 1, SCRATCH_BUFSIZE, fd);
+  size_t remaining = file_stat.st_size > 0 ? last - first + 1 : 0;
+  esp_err_t ret = ESP_OK;
+  while (remaining > 0) {
+    /* Read file in chunks into the transfer buffer */
+    size_t chunksize = fread(chunk, 1, MIN(remaining, HTTP_BUFFER_SIZE), fd);
+    if (chunksize == 0) {
+      break;
+    }
+    remaining -= chunksize;
 
     /* Send the buffer contents as HTTP response chunk */
     if (httpd_resp_send_chunk(req, chunk, chunksize) != ESP_OK) {
-      fclose(fd);
       ESP_LOGE(HTTP_TAG, "File sending failed!");
-      /* Abort sending file */
-      httpd_resp_sendstr_chunk(req, NULL);
-      /* Respond with 500 Internal Server Error */
-      httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to send file");
-      return ESP_FAIL;
+      ret = ESP_FAIL;
+      break;
     }
+  }
 
-    /* Keep looping till the whole file is sent */
-  } while (chunksize != 0);
-
-  /* Close file after sending complete */
+  /* Close file and return the buffer after sending complete */
   fclose(fd);
+  xQueueSend(server->buffers, &chunk, 0);
+
+  if (ret != ESP_OK) {
+    /* Abort sending file */
+    httpd_resp_sendstr_chunk(req, NULL);
+    /* Respond with 500 Internal Server Error */
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to send file");
+    return ESP_FAIL;
+  }
   ESP_LOGI(HTTP_TAG, "File sending complete");
 
   /* Respond with an empty chunk to signal HTTP response completion */
@@ -215,11 +371,234 @@ static esp_err_t download_get_handler(httpd_req_t *req) {
   return ESP_OK;
 }
 
+/* Returns unsigned integer query parameter, or fallback when missing */
+static uint32_t http_query_uint(httpd_req_t *req, const char *key, uint32_t fallback) {
+  char query[32];
+  char value[12];
+
+  if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+      httpd_query_key_value(query, key, value, sizeof(value)) == ESP_OK) {
+    return strtoul(value, NULL, 10);
+  }
+  return fallback;
+}
+
+/* Handler listing ride history from the ride index, optionally starting at ?from=<unix time> */
+static esp_err_t rides_get_handler(httpd_req_t *req) {
+  uint32_t from = http_query_uint(req, "from", 0);
+
+  httpd_resp_set_type(req, "text/csv");
+  httpd_resp_sendstr_chunk(req, "start_time,duration,distance,energy,synced,filename\n");
+
+  struct RideIndexCursor cursor;
+  struct RideIndexRecord record;
+  char line[100];
+
+  ride_index_open(&cursor, from);
+  while (ride_index_next(&cursor, &record)) {
+    snprintf(line, sizeof(line), "%d,%d,%.3f,%.2f,%d,%.*s\n", record.start_time, record.duration, record.distance,
+             record.energy, (record.flags & RIDE_INDEX_FLAG_SYNCED) != 0, RIDE_INDEX_FILENAME_MAX, record.filename);
+    httpd_resp_sendstr_chunk(req, line);
+  }
+  ride_index_close(&cursor);
+
+  httpd_resp_sendstr_chunk(req, NULL);
+  return ESP_OK;
+}
+
+/* JSON writer flush callback, every full writer buffer goes out as one chunk */
+static bool http_json_flush(const char *data, size_t length, void *context) {
+  return httpd_resp_send_chunk((httpd_req_t *)context, data, length) == ESP_OK;
+}
+
+static esp_err_t http_json_begin(httpd_req_t *req, struct JsonWriter *writer) {
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+  json_writer_init(writer, http_json_flush, req);
+  json_begin_object(writer, NULL);
+  return ESP_OK;
+}
+
+static esp_err_t http_json_end(httpd_req_t *req, struct JsonWriter *writer) {
+  json_end_object(writer);
+  if (!json_writer_finish(writer)) {
+    ESP_LOGE(HTTP_TAG, "JSON response aborted");
+    return ESP_FAIL;
+  }
+  httpd_resp_send_chunk(req, NULL, 0);
+  return ESP_OK;
+}
+
+/* Live state, same values as exposed over BLE */
+static esp_err_t api_state_get_handler(httpd_req_t *req) {
+  struct JsonWriter writer;
+  struct CurrentState *state = state_get();
+
+  http_json_begin(req, &writer);
+  json_int(&writer, "device_state", state_get_device_state());
+  json_int(&writer, "riding_state", state->riding_state);
+  json_int(&writer, "riding_time", state->riding_time);
+
+  json_begin_object(&writer, "battery");
+  json_double(&writer, "voltage", state->voltage.value, 3);
+  json_double(&writer, "current", state->current.value, 3);
+  json_double(&writer, "used_energy", state->used_energy.value, 3);
+  json_double(&writer, "total_energy", state->total_energy.value, 3);
+  json_double(&writer, "state_of_charge", state->state_of_charge.value, 1);
+  json_double(&writer, "range", state->range.value, 2);
+  json_end_object(&writer);
+
+  json_begin_object(&writer, "gps");
+  json_int(&writer, "fix_status", state->gps_fix_status);
+  json_int(&writer, "satelites", state->gps_satelites_count);
+  json_double(&writer, "latitude", state->latitude.value, 7);
+  json_double(&writer, "longitude", state->longitude.value, 7);
+  json_double(&writer, "altitude", state->altitude.value, 1);
+  json_double(&writer, "speed", state->speed.value, 2);
+  json_double(&writer, "heading", state->heading.value, 1);
+  json_double(&writer, "trip_distance", state->trip_distance.value, 3);
+  json_end_object(&writer);
+
+  return http_json_end(req, &writer);
+}
+
+/* Ride history from the ride index, optionally starting at ?from=<unix time> and capped by ?limit= */
+static esp_err_t api_rides_get_handler(httpd_req_t *req) {
+  struct JsonWriter writer;
+  struct RideIndexCursor cursor;
+  struct RideIndexRecord record;
+  uint32_t from = http_query_uint(req, "from", 0);
+  uint32_t limit = http_query_uint(req, "limit", UINT32_MAX);
+
+  ride_index_open(&cursor, from);
+
+  http_json_begin(req, &writer);
+  json_int(&writer, "count", cursor.count);
+  json_int(&writer, "position", cursor.position);
+  json_begin_array(&writer, "rides");
+
+  for (; limit > 0 && !writer.failed && ride_index_next(&cursor, &record); limit--) {
+    json_begin_object(&writer, NULL);
+    json_int(&writer, "start_time", record.start_time);
+    json_int(&writer, "duration", record.duration);
+    json_double(&writer, "distance", record.distance, 3);
+    json_double(&writer, "energy", record.energy, 2);
+    json_bool(&writer, "synced", (record.flags & RIDE_INDEX_FLAG_SYNCED) != 0);
+    json_string(&writer, "filename", record.filename, RIDE_INDEX_FILENAME_MAX);
+    json_end_object(&writer);
+  }
+  ride_index_close(&cursor);
+
+  json_end_array(&writer);
+  return http_json_end(req, &writer);
+}
+
+/* Device health: storage, memory, telemetry counters and the last ride summary */
+static esp_err_t api_stats_get_handler(httpd_req_t *req) {
+  struct JsonWriter writer;
+  struct RideSummary *summary = ride_summary_get();
+
+  http_json_begin(req, &writer);
+  json_int(&writer, "uptime", esp_timer_get_time() / 1000000);
+  json_int(&writer, "free_heap", esp_get_free_heap_size());
+  json_int(&writer, "min_free_heap", esp_get_minimum_free_heap_size());
+
+  json_begin_object(&writer, "storage");
+  json_int(&writer, "free_mb", storage_space_free_mb());
+  json_int(&writer, "total_mb", storage_space_total_mb());
+  json_int(&writer, "rides", ride_index_count());
+  json_end_object(&writer);
+
+  json_begin_object(&writer, "telemetry");
+  json_bool(&writer, "active", telemetry_is_active());
+  json_int(&writer, "samples", telemetry_stats.samples);
+  json_int(&writer, "dropped_adc", telemetry_stats.dropped_adc);
+  json_int(&writer, "dropped_gps", telemetry_stats.dropped_gps);
+  json_int(&writer, "bytes", telemetry_stats.bytes);
+  json_int(&writer, "throughput", telemetry_stats.throughput);
+  json_end_object(&writer);
+
+  json_begin_object(&writer, "last_ride");
+  json_int(&writer, "start_time", summary->start_time);
+  json_int(&writer, "duration", summary->duration);
+  json_double(&writer, "distance", summary->distance, 3);
+  json_double(&writer, "max_speed", summary->max_speed, 2);
+  json_double(&writer, "average_speed", summary->average_speed, 2);
+  json_double(&writer, "energy", summary->energy, 2);
+  json_double(&writer, "energy_per_km", summary->energy_per_km, 2);
+  json_double(&writer, "elevation_gain", summary->elevation_gain, 1);
+  json_double(&writer, "max_current", summary->max_current, 2);
+  json_end_object(&writer);
+
+  return http_json_end(req, &writer);
+}
+
+/* Settings, secrets (passwords and device key) are never exposed */
+static esp_err_t api_settings_get_handler(httpd_req_t *req) {
+  struct JsonWriter writer;
+
+  http_json_begin(req, &writer);
+  json_bool(&writer, "manual_ride_start", settings.manual_ride_start);
+  json_int(&writer, "wifi_state", settings.wifi_state);
+  json_string(&writer, "wifi_ssid", (const char *)settings.wifi_ssid, sizeof(settings.wifi_ssid));
+  json_string(&writer, "wifi_ssid_client", (const char *)settings.wifi_ssid_client,
+              sizeof(settings.wifi_ssid_client));
+  json_int(&writer, "upload_interval", settings.upload_interval);
+  json_int(&writer, "battery_cells", settings.battery_cells);
+  json_int(&writer, "battery_capacity", settings.battery_capacity);
+  json_int(&writer, "log_backend", settings.log_backend);
+  json_int(&writer, "telemetry_rate", settings.telemetry_rate);
+
+  json_begin_object(&writer, "activity");
+  json_int(&writer, "riding_current_level", settings.activity.riding_current_level);
+  json_int(&writer, "charging_current_level", settings.activity.charging_current_level);
+  json_int(&writer, "hysteresis", settings.activity.hysteresis);
+  json_int(&writer, "start_time", settings.activity.start_time);
+  json_int(&writer, "idle_time", settings.activity.idle_time);
+  json_int(&writer, "riding_speed_level", settings.activity.riding_speed_level);
+  json_end_object(&writer);
+
+  json_begin_array(&writer, "wifi_profiles");
+  for (uint8_t i = 0; i < WIFI_PROFILE_COUNT; i++) {
+    struct WifiProfile *profile = &settings.wifi_profiles[i];
+    if (profile->ssid[0] == 0) {
+      continue;
+    }
+    json_begin_object(&writer, NULL);
+    json_int(&writer, "index", i);
+    json_string(&writer, "ssid", (const char *)profile->ssid, sizeof(profile->ssid));
+    json_int(&writer, "priority", profile->priority);
+    json_int(&writer, "last_rssi", profile->last_rssi);
+    json_end_object(&writer);
+  }
+  json_end_array(&writer);
+
+  json_begin_object(&writer, "retention");
+  json_int(&writer, "max_age_days", settings.retention.max_age_days);
+  json_int(&writer, "max_synced_mb", settings.retention.max_synced_mb);
+  json_int(&writer, "min_free_mb", settings.retention.min_free_mb);
+  json_end_object(&writer);
+
+  return http_json_end(req, &writer);
+}
+
 esp_err_t start_file_server(const char *base_path) {
+  if (server != NULL) {
+    return ESP_OK;
+  }
 
   strlcpy(server_data.base_path, base_path, sizeof(server_data.base_path));
 
-  httpd_handle_t server = NULL;
+  if (server_data.buffers == NULL) {
+    server_data.buffers = xQueueCreate(HTTP_BUFFER_COUNT, sizeof(char *));
+    for (uint8_t i = 0; i < HTTP_BUFFER_COUNT; i++) {
+      char *buffer = malloc(HTTP_BUFFER_SIZE);
+      if (buffer != NULL) {
+        xQueueSend(server_data.buffers, &buffer, 0);
+      }
+    }
+  }
+
   httpd_config_t config = HTTPD_DEFAULT_CONFIG();
 
   config.uri_match_fn = httpd_uri_match_wildcard;
@@ -227,9 +606,29 @@ esp_err_t start_file_server(const char *base_path) {
   ESP_LOGI(HTTP_TAG, "Starting HTTP Server");
   if (httpd_start(&server, &config) != ESP_OK) {
     ESP_LOGE(HTTP_TAG, "Failed to start file server!");
+    server = NULL;
     return ESP_FAIL;
   }
 
+  httpd_uri_t rides = {
+      .uri = "/rides",
+      .method = HTTP_GET,
+      .handler = rides_get_handler,
+      .user_ctx = &server_data,
+  };
+  httpd_register_uri_handler(server, &rides);
+
+  httpd_uri_t api_handlers[] = {
+      {.uri = "/api/state", .method = HTTP_GET, .handler = api_state_get_handler, .user_ctx = &server_data},
+      {.uri = "/api/rides", .method = HTTP_GET, .handler = api_rides_get_handler, .user_ctx = &server_data},
+      {.uri = "/api/stats", .method = HTTP_GET, .handler = api_stats_get_handler, .user_ctx = &server_data},
+      {.uri = "/api/settings", .method = HTTP_GET, .handler = api_settings_get_handler, .user_ctx = &server_data},
+  };
+  for (uint8_t i = 0; i < sizeof(api_handlers) / sizeof(api_handlers[0]); i++) {
+    httpd_register_uri_handler(server, &api_handlers[i]);
+  }
+  live_stream_register(server);
+
   httpd_uri_t file_download = {
       .uri = "/*", // Match all URIs of type /path/to/file
       .method = HTTP_GET,
@@ -0,0 +1,132 @@
+#include "json_writer.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static void json_flush(struct JsonWriter *writer) {
+  if (writer->length > 0 && !writer->failed) {
+    writer->failed = !writer->flush(writer->buffer, writer->length, writer->context);
+  }
+  writer->length = 0;
+}
+
+static void json_put(struct JsonWriter *writer, const char *data, size_t length) {
+  while (length > 0) {
+    if (writer->length == sizeof(writer->buffer)) {
+      json_flush(writer);
+    }
+
+    size_t part = sizeof(writer->buffer) - writer->length;
+    part = length < part ? length : part;
+    memcpy(writer->buffer + writer->length, data, part);
+    writer->length += part;
+    data += part;
+    length -= part;
+  }
+}
+
+static void json_put_char(struct JsonWriter *writer, char c) { json_put(writer, &c, 1); }
+
+static void json_put_escaped(struct JsonWriter *writer, const char *value, size_t max_length) {
+  char escape[8];
+
+  json_put_char(writer, '"');
+  for (size_t i = 0; i < max_length && value[i] != 0; i++) {
+    unsigned char c = value[i];
+    if (c == '"' || c == '\\') {
+      escape[0] = '\\';
+      escape[1] = c;
+      json_put(writer, escape, 2);
+    } else if (c < 0x20) {
+      snprintf(escape, sizeof(escape), "\\u%04x", c);
+      json_put(writer, escape, 6);
+    } else {
+      json_put_char(writer, c);
+    }
+  }
+  json_put_char(writer, '"');
+}
+
+// Separator and key for the next value, one bit per nesting level remembers whether a comma is due
+static void json_key(struct JsonWriter *writer, const char *key) {
+  uint32_t bit = 1u << writer->depth;
+
+  if (writer->has_items & bit) {
+    json_put_char(writer, ',');
+  }
+  writer->has_items |= bit;
+
+  if (key != NULL) {
+    json_put_escaped(writer, key, strlen(key));
+    json_put_char(writer, ':');
+  }
+}
+
+void json_writer_init(struct JsonWriter *writer, json_writer_flush_t flush, void *context) {
+  writer->length = 0;
+  writer->depth = 0;
+  writer->has_items = 0;
+  writer->failed = false;
+  writer->flush = flush;
+  writer->context = context;
+}
+
+bool json_writer_finish(struct JsonWriter *writer) {
+  json_flush(writer);
+  return !writer->failed;
+}
+
+static void json_begin(struct JsonWriter *writer, const char *key, char bracket) {
+  json_key(writer, key);
+  json_put_char(writer, bracket);
+
+  if (writer->depth < JSON_WRITER_MAX_DEPTH) {
+    writer->depth++;
+    writer->has_items &= ~(1u << writer->depth);
+  }
+}
+
+static void json_end(struct JsonWriter *writer, char bracket) {
+  if (writer->depth > 0) {
+    writer->depth--;
+  }
+  json_put_char(writer, bracket);
+}
+
+void json_begin_object(struct JsonWriter *writer, const char *key) { json_begin(writer, key, '{'); }
+void json_end_object(struct JsonWriter *writer) { json_end(writer, '}'); }
+void json_begin_array(struct JsonWriter *writer, const char *key) { json_begin(writer, key, '['); }
+void json_end_array(struct JsonWriter *writer) { json_end(writer, ']'); }
+
+void json_int(struct JsonWriter *writer, const char *key, int64_t value) {
+  char number[24];
+  json_key(writer, key);
+  json_put(writer, number, snprintf(number, sizeof(number), "%lld", (long long)value));
+}
+
+// JSON has no NaN or infinity, those are written as null
+void json_double(struct JsonWriter *writer, const char *key, double value, uint8_t decimals) {
+  char number[32];
+  json_key(writer, key);
+
+  if (isnan(value) || isinf(value)) {
+    json_put(writer, "null", 4);
+    return;
+  }
+  int length = snprintf(number, sizeof(number), "%.*f", decimals, value);
+  json_put(writer, number, length < (int)sizeof(number) ? length : sizeof(number) - 1);
+}
+
+void json_bool(struct JsonWriter *writer, const char *key, bool value) {
+  json_key(writer, key);
+  if (value) {
+    json_put(writer, "true", 4);
+  } else {
+    json_put(writer, "false", 5);
+  }
+}
+
+void json_string(struct JsonWriter *writer, const char *key, const char *value, size_t max_length) {
+  json_key(writer, key);
+  json_put_escaped(writer, value, max_length);
+}
@@ -0,0 +1,37 @@
+#ifndef json_writer_h
+#define json_writer_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_WRITER_BUFFER_SIZE 512
+#define JSON_WRITER_MAX_DEPTH 16
+
+typedef bool (*json_writer_flush_t)(const char *data, size_t length, void *context);
+
+// Streams JSON through a fixed buffer, handing full buffers to the flush callback
+struct JsonWriter {
+  char buffer[JSON_WRITER_BUFFER_SIZE];
+  size_t length;
+  uint8_t depth;
+  uint32_t has_items;
+  bool failed;
+  json_writer_flush_t flush;
+  void *context;
+};
+
+void json_writer_init(struct JsonWriter *writer, json_writer_flush_t flush, void *context);
+bool json_writer_finish(struct JsonWriter *writer);
+
+void json_begin_object(struct JsonWriter *writer, const char *key);
+void json_end_object(struct JsonWriter *writer);
+void json_begin_array(struct JsonWriter *writer, const char *key);
+void json_end_array(struct JsonWriter *writer);
+
+void json_int(struct JsonWriter *writer, const char *key, int64_t value);
+void json_double(struct JsonWriter *writer, const char *key, double value, uint8_t decimals);
+void json_bool(struct JsonWriter *writer, const char *key, bool value);
+void json_string(struct JsonWriter *writer, const char *key, const char *value, size_t max_length);
+
+#endif
@@ -0,0 +1,145 @@
+#include "kalman.h"
+#include "math.h"
+
+#define d2r (M_PI / 180.0)
+#define EARTH_RADIUS_M 6367000.0
+
+// acceleration noise of a board in m/s^2, measurement noise in m and m/s
+#define KALMAN_ACCELERATION_NOISE 2.0f
+#define KALMAN_POSITION_NOISE 4.0f
+#define KALMAN_VELOCITY_NOISE 0.5f
+// without a position for this long the filter restarts on the next fix and stops extrapolating
+#define KALMAN_RESET_TIMEOUT_US (5 * 1000 * 1000)
+#define KALMAN_MIN_HEADING_SPEED 0.3f
+
+// Constant velocity model, east and north axes are filtered independently
+struct KalmanAxis {
+  float position;
+  float velocity;
+  float p00;
+  float p01;
+  float p11;
+};
+
+static struct KalmanAxis east;
+static struct KalmanAxis north;
+
+static bool is_initialized = false;
+static double origin_latitude;
+static double origin_longitude;
+static double meters_per_degree_longitude;
+static int64_t last_time = 0;
+static int64_t last_position_time = 0;
+static float heading = 0;
+
+static void kalman_axis_init(struct KalmanAxis *axis, float position) {
+  axis->position = position;
+  axis->velocity = 0;
+  axis->p00 = KALMAN_POSITION_NOISE * KALMAN_POSITION_NOISE;
+  axis->p01 = 0;
+  axis->p11 = 100;
+}
+
+static void kalman_axis_predict(struct KalmanAxis *axis, float dt) {
+  float q = KALMAN_ACCELERATION_NOISE * KALMAN_ACCELERATION_NOISE;
+  float dt2 = dt * dt;
+
+  axis->position += axis->velocity * dt;
+  axis->p00 += dt * (2 * axis->p01 + dt * axis->p11) + q * dt2 * dt2 / 4;
+  axis->p01 += dt * axis->p11 + q * dt2 * dt / 2;
+  axis->p11 += q * dt2;
+}
+
+static void kalman_axis_update_position(struct KalmanAxis *axis, float position) {
+  float s = axis->p00 + KALMAN_POSITION_NOISE * KALMAN_POSITION_NOISE;
+  float k0 = axis->p00 / s;
+  float k1 = axis->p01 / s;
+  float y = position - axis->position;
+
+  axis->position += k0 * y;
+  axis->velocity += k1 * y;
+  axis->p11 -= k1 * axis->p01;
+  axis->p00 *= 1 - k0;
+  axis->p01 *= 1 - k0;
+}
+
+static void kalman_axis_update_velocity(struct KalmanAxis *axis, float velocity) {
+  float s = axis->p11 + KALMAN_VELOCITY_NOISE * KALMAN_VELOCITY_NOISE;
+  float k0 = axis->p01 / s;
+  float k1 = axis->p11 / s;
+  float y = velocity - axis->velocity;
+
+  axis->position += k0 * y;
+  axis->velocity += k1 * y;
+  axis->p00 -= k0 * axis->p01;
+  axis->p01 *= 1 - k1;
+  axis->p11 *= 1 - k1;
+}
+
+static void kalman_predict(int64_t time_us) {
+  float dt = (time_us - last_time) / 1000000.0f;
+  if (dt > 0) {
+    kalman_axis_predict(&east, dt);
+    kalman_axis_predict(&north, dt);
+    last_time = time_us;
+  }
+}
+
+void kalman_reset() { is_initialized = false; }
+
+void kalman_update_position(double latitude, double longitude, int64_t time_us) {
+  if (!is_initialized || time_us - last_position_time > KALMAN_RESET_TIMEOUT_US) {
+    origin_latitude = latitude;
+    origin_longitude = longitude;
+    meters_per_degree_longitude = EARTH_RADIUS_M * d2r * cos(latitude * d2r);
+
+    kalman_axis_init(&east, 0);
+    kalman_axis_init(&north, 0);
+    last_time = time_us;
+    last_position_time = time_us;
+    is_initialized = true;
+    return;
+  }
+
+  kalman_predict(time_us);
+  kalman_axis_update_position(&east, (longitude - origin_longitude) * meters_per_degree_longitude);
+  kalman_axis_update_position(&north, (latitude - origin_latitude) * EARTH_RADIUS_M * d2r);
+  last_position_time = time_us;
+}
+
+void kalman_update_velocity(double speed, double course, int64_t time_us) {
+  if (!is_initialized) {
+    return;
+  }
+
+  float velocity = speed / 3.6;
+  float angle = course * d2r;
+
+  kalman_predict(time_us);
+  kalman_axis_update_velocity(&east, velocity * sinf(angle));
+  kalman_axis_update_velocity(&north, velocity * cosf(angle));
+}
+
+// Predictions are only handed out for a bounded time after the last position, past that the fix counts as lost
+bool kalman_get_estimate(int64_t time_us, struct KalmanEstimate *estimate) {
+  if (!is_initialized || time_us - last_position_time > KALMAN_RESET_TIMEOUT_US) {
+    return false;
+  }
+
+  kalman_predict(time_us);
+
+  float velocity = sqrtf(east.velocity * east.velocity + north.velocity * north.velocity);
+  if (velocity > KALMAN_MIN_HEADING_SPEED) {
+    heading = atan2f(east.velocity, north.velocity) / d2r;
+    if (heading < 0) {
+      heading += 360;
+    }
+  }
+
+  estimate->latitude = origin_latitude + north.position / (EARTH_RADIUS_M * d2r);
+  estimate->longitude = origin_longitude + east.position / meters_per_degree_longitude;
+  estimate->speed = velocity * 3.6;
+  estimate->heading = heading;
+
+  return true;
+}
@@ -0,0 +1,19 @@
+#ifndef kalman_h
+#define kalman_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct KalmanEstimate {
+  double latitude;
+  double longitude;
+  double speed;
+  double heading;
+};
+
+void kalman_reset();
+void kalman_update_position(double latitude, double longitude, int64_t time_us);
+void kalman_update_velocity(double speed, double course, int64_t time_us);
+bool kalman_get_estimate(int64_t time_us, struct KalmanEstimate *estimate);
+
+#endif
@@ -0,0 +1,173 @@
+#include "live_stream.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "telemetry.h"
+#include "wifi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+static const char *TAG = "live_stream";
+
+static TaskHandle_t live_stream_task_handle = NULL;
+static httpd_handle_t live_server = NULL;
+static int live_fd = -1;
+
+static uint8_t requested_rate = 0;
+static char frame_buffer[LIVE_STREAM_FRAME_SIZE];
+
+static bool live_stream_send(const char *data, size_t length) {
+  httpd_ws_frame_t frame = {
+      .type = HTTPD_WS_TYPE_TEXT,
+      .payload = (uint8_t *)data,
+      .len = length,
+  };
+  return httpd_ws_send_frame_async(live_server, live_fd, &frame) == ESP_OK;
+}
+
+static void live_stream_disconnect() {
+  telemetry_live_stop();
+  live_fd = -1;
+  ESP_LOGI(TAG, "Client disconnected");
+}
+
+// Streams the samples queued by telemetry, each frame holds whole lines in the telemetry log format.
+// When the client cannot keep up (ring overflows or slow sends) adc samples are thinned out by doubling
+// the minimum spacing between them, and the spacing recovers towards the requested rate on clean frames.
+static void live_stream_task(void *pvParameters) {
+  struct TelemetrySample sample;
+  int64_t last_adc = 0;
+  int64_t interval_us = 0;
+  uint32_t dropped = 0;
+
+  while (1) {
+    // a notification means a new client or a new rate, block on it while nobody is listening
+    bool restart = ulTaskNotifyTake(pdTRUE, live_fd < 0 ? portMAX_DELAY : 0) > 0;
+    if (live_fd < 0) {
+      continue;
+    }
+
+    if (restart) {
+      telemetry_live_start(requested_rate);
+      interval_us = 1000000 / MIN(MAX(requested_rate, TELEMETRY_RATE_MIN), TELEMETRY_RATE_MAX);
+      last_adc = 0;
+      dropped = 0;
+
+      if (!live_stream_send(TELEMETRY_HEADER, strlen(TELEMETRY_HEADER))) {
+        live_stream_disconnect();
+      }
+      continue;
+    }
+
+    if (wifi_get_state() != WIFI_AP || httpd_ws_get_fd_info(live_server, live_fd) != HTTPD_WS_CLIENT_WEBSOCKET) {
+      live_stream_disconnect();
+      continue;
+    }
+
+    size_t length = 0;
+    bool has_more = false;
+
+    while (length + TELEMETRY_LINE_MAX <= sizeof(frame_buffer)) {
+      if (!telemetry_live_pop(&sample)) {
+        break;
+      }
+      if (sample.type == TELEMETRY_SAMPLE_ADC) {
+        if (sample.timestamp - last_adc < interval_us) {
+          continue;
+        }
+        last_adc = sample.timestamp;
+      }
+      length += MIN(telemetry_format(&sample, frame_buffer + length, TELEMETRY_LINE_MAX), TELEMETRY_LINE_MAX - 1);
+      has_more = length + TELEMETRY_LINE_MAX > sizeof(frame_buffer);
+    }
+
+    uint32_t total_dropped = telemetry_live_dropped();
+    if (total_dropped != dropped) {
+      length += MIN(snprintf(frame_buffer + length, sizeof(frame_buffer) - length, "D,%lld,%d\n",
+                             esp_timer_get_time(), total_dropped),
+                    sizeof(frame_buffer) - length - 1);
+    }
+
+    int64_t send_start = esp_timer_get_time();
+    if (length > 0 && !live_stream_send(frame_buffer, length)) {
+      live_stream_disconnect();
+      continue;
+    }
+    int64_t send_time_us = esp_timer_get_time() - send_start;
+
+    int64_t target_us = 1000000 / MIN(MAX(requested_rate, TELEMETRY_RATE_MIN), TELEMETRY_RATE_MAX);
+    if (total_dropped != dropped || send_time_us > LIVE_STREAM_SLOW_SEND_MS * 1000) {
+      interval_us = MIN(interval_us * 2, LIVE_STREAM_MAX_INTERVAL_US);
+      ESP_LOGI(TAG, "Client too slow, adc interval %lld us", interval_us);
+    } else if (interval_us > target_us) {
+      interval_us = MAX(interval_us * 3 / 4, target_us);
+    }
+    dropped = total_dropped;
+
+    if (!has_more) {
+      vTaskDelay(LIVE_STREAM_PERIOD_MS / portTICK_PERIOD_MS);
+    }
+  }
+}
+
+// Handshake is a GET to /api/live?rate=<Hz>, text frames sent by the client in the form "rate=<Hz>" change it
+static esp_err_t live_stream_handler(httpd_req_t *req) {
+  char value[8];
+
+  if (req->method == HTTP_GET) {
+    if (wifi_get_state() != WIFI_AP) {
+      return ESP_FAIL;
+    }
+
+    char query[16];
+    requested_rate = TELEMETRY_RATE_MAX;
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "rate", value, sizeof(value)) == ESP_OK) {
+      requested_rate = atoi(value);
+    }
+
+    live_server = req->handle;
+    live_fd = httpd_req_to_sockfd(req);
+    ESP_LOGI(TAG, "Client connected at %d Hz", requested_rate);
+    xTaskNotifyGive(live_stream_task_handle);
+    return ESP_OK;
+  }
+
+  httpd_ws_frame_t frame = {.type = HTTPD_WS_TYPE_TEXT};
+  if (httpd_ws_recv_frame(req, &frame, 0) != ESP_OK) {
+    return ESP_FAIL;
+  }
+  if (frame.len == 0 || frame.len >= sizeof(value)) {
+    return ESP_OK;
+  }
+
+  frame.payload = (uint8_t *)value;
+  if (httpd_ws_recv_frame(req, &frame, frame.len) != ESP_OK) {
+    return ESP_FAIL;
+  }
+  value[frame.len] = 0;
+
+  if (frame.type == HTTPD_WS_TYPE_TEXT && strncmp(value, "rate=", 5) == 0) {
+    requested_rate = atoi(value + 5);
+    xTaskNotifyGive(live_stream_task_handle);
+  }
+  return ESP_OK;
+}
+
+esp_err_t live_stream_register(httpd_handle_t server) {
+  if (live_stream_task_handle == NULL) {
+    xTaskCreate(live_stream_task, "live_stream_task", 3072, NULL, 5, &live_stream_task_handle);
+  }
+
+  httpd_uri_t live = {
+      .uri = LIVE_STREAM_URI,
+      .method = HTTP_GET,
+      .handler = live_stream_handler,
+      .user_ctx = NULL,
+      .is_websocket = true,
+  };
+  return httpd_register_uri_handler(server, &live);
+}
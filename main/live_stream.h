@@ -0,0 +1,14 @@
+#ifndef live_stream_h
+#define live_stream_h
+
+#include "esp_http_server.h"
+
+#define LIVE_STREAM_URI "/api/live"
+#define LIVE_STREAM_FRAME_SIZE 1400
+#define LIVE_STREAM_PERIOD_MS 100
+#define LIVE_STREAM_SLOW_SEND_MS 200
+#define LIVE_STREAM_MAX_INTERVAL_US 1000000
+
+esp_err_t live_stream_register(httpd_handle_t server);
+
+#endif
@@ -0,0 +1,86 @@
+#include "log_export.h"
+#include "esp_log.h"
+#include "log_record.h"
+#include <string.h>
+#include <sys/param.h>
+
+static const char *TAG = "log_export";
+
+bool log_export_open(struct LogExport *export, const char *path, log_export_format_t format) {
+  struct LogRecordFileHeader header;
+
+  export->file = fopen(path, "r");
+  if (export->file == NULL) {
+    ESP_LOGE(TAG, "Failed to open %s", path);
+    return false;
+  }
+
+  export->format = format;
+  export->header_sent = false;
+  export->is_binary = fread(&header, sizeof(header), 1, export->file) == 1 && header.magic == LOG_RECORD_FILE_MAGIC &&
+                      header.record_size > 0;
+
+  if (export->is_binary) {
+    export->record_size = header.record_size;
+  } else {
+    rewind(export->file);
+  }
+  return true;
+}
+
+// Fills buffer with whole lines only, returns 0 once the file is exhausted
+size_t log_export_read(struct LogExport *export, char *buffer, size_t len) {
+  if (!export->is_binary) {
+    return fread(buffer, 1, len, export->file);
+  }
+
+  size_t length = 0;
+  if (!export->header_sent && export->format == LOG_EXPORT_CSV) {
+    length = MIN(strlen(LOG_RECORD_HEADER), len);
+    memcpy(buffer, LOG_RECORD_HEADER, length);
+  }
+  export->header_sent = true;
+
+  struct LogRecord record;
+  size_t copy_size = MIN(export->record_size, sizeof(record));
+  long skip = export->record_size - copy_size;
+
+  // a partially written record at the end of an interrupted ride is dropped
+  while (length + LOG_RECORD_LINE_MAX <= len) {
+    memset(&record, 0, sizeof(record));
+    if (fread(&record, copy_size, 1, export->file) != 1 || (skip > 0 && fseek(export->file, skip, SEEK_CUR) != 0)) {
+      break;
+    }
+
+    int line_length = export->format == LOG_EXPORT_JSON_LINES
+                          ? log_record_format_json(&record, buffer + length, LOG_RECORD_LINE_MAX)
+                          : log_record_format(&record, buffer + length, LOG_RECORD_LINE_MAX);
+    length += MIN(line_length, LOG_RECORD_LINE_MAX - 1);
+  }
+  return length;
+}
+
+void log_export_close(struct LogExport *export) {
+  if (export->file != NULL) {
+    fclose(export->file);
+    export->file = NULL;
+  }
+}
+
+// Length of the converted text, needs a full pass over binary files so only use it where a length must be known
+// up front
+size_t log_export_size(const char *path, log_export_format_t format) {
+  struct LogExport export;
+  char buffer[LOG_RECORD_LINE_MAX * 2];
+  size_t size = 0;
+  size_t length;
+
+  if (!log_export_open(&export, path, format)) {
+    return 0;
+  }
+  while ((length = log_export_read(&export, buffer, sizeof(buffer))) > 0) {
+    size += length;
+  }
+  log_export_close(&export);
+  return size;
+}
@@ -0,0 +1,25 @@
+#ifndef log_export_h
+#define log_export_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum { LOG_EXPORT_CSV, LOG_EXPORT_JSON_LINES } log_export_format_t;
+
+// Streams a log file as text. Binary logs are converted record by record, text logs are passed through as stored
+struct LogExport {
+  FILE *file;
+  uint8_t format;
+  bool is_binary;
+  bool header_sent;
+  uint16_t record_size;
+};
+
+bool log_export_open(struct LogExport *export, const char *path, log_export_format_t format);
+size_t log_export_read(struct LogExport *export, char *buffer, size_t len);
+void log_export_close(struct LogExport *export);
+size_t log_export_size(const char *path, log_export_format_t format);
+
+#endif
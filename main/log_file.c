@@ -0,0 +1,145 @@
+#include "log_file.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "logger.h"
+#include "storage_space.h"
+#include <string.h>
+
+static const char *TAG = "log_file";
+
+// FatFs works on paths relative to the mounted volume, the VFS prefix has to be dropped
+static const char *log_file_fatfs_path(const char *name) {
+  size_t base_length = strlen(BASE_LOCATION);
+
+  if (strncmp(name, BASE_LOCATION, base_length) == 0) {
+    return name + base_length;
+  }
+  return name;
+}
+
+// Bucket i holds latencies below 2^i ms, the last one everything above
+static void log_file_record_latency(struct LogFile *log_file, uint32_t latency_us) {
+  uint8_t bucket = 0;
+  uint32_t limit_us = 1000;
+
+  while (bucket < LOG_FILE_LATENCY_BUCKETS - 1 && latency_us >= limit_us) {
+    bucket++;
+    limit_us <<= 1;
+  }
+
+  log_file->latency_histogram[bucket]++;
+  log_file->writes++;
+  if (latency_us > log_file->max_latency_us) {
+    log_file->max_latency_us = latency_us;
+  }
+}
+
+// Reports clusters the file took or released since the last call to the free space tracker
+static void log_file_account(struct LogFile *log_file) {
+  uint32_t clusters = storage_space_clusters(f_size(&log_file->file));
+
+  if (clusters != log_file->clusters) {
+    storage_space_allocate((int32_t)clusters - (int32_t)log_file->clusters);
+    log_file->clusters = clusters;
+  }
+}
+
+// Creates the file and reserves a contiguous cluster run for it, so appends never have to walk and extend the FAT
+bool log_file_open(struct LogFile *log_file, const char *name, uint32_t preallocate_size) {
+  memset(log_file, 0, sizeof(struct LogFile));
+
+  FRESULT res = f_open(&log_file->file, log_file_fatfs_path(name), FA_CREATE_ALWAYS | FA_WRITE);
+  if (res != FR_OK) {
+    ESP_LOGE(TAG, "Failed to open file for writing %s %d", name, res);
+    return false;
+  }
+  log_file->is_open = true;
+
+  if (preallocate_size > 0) {
+    res = f_expand(&log_file->file, preallocate_size, 1);
+    if (res == FR_OK) {
+      log_file->is_contiguous = true;
+      log_file_account(log_file);
+    } else {
+      // Not enough contiguous free space, fall back to growing the chain on demand
+      ESP_LOGE(TAG, "Failed to preallocate %d bytes for %s %d", preallocate_size, name, res);
+    }
+  }
+
+  return true;
+}
+
+// Reopens a file closed after a failed write and appends from its end, the clusters it holds are already counted
+bool log_file_reopen(struct LogFile *log_file, const char *name) {
+  memset(log_file, 0, sizeof(struct LogFile));
+
+  FRESULT res = f_open(&log_file->file, log_file_fatfs_path(name), FA_OPEN_APPEND | FA_WRITE);
+  if (res != FR_OK) {
+    ESP_LOGE(TAG, "Failed to reopen file %s %d", name, res);
+    return false;
+  }
+  log_file->is_open = true;
+  log_file->clusters = storage_space_clusters(f_size(&log_file->file));
+
+  return true;
+}
+
+// A failed write moves the position back to where it started, closing then truncates the partial data away
+bool log_file_write(struct LogFile *log_file, const char *data, size_t length) {
+  if (!log_file->is_open) {
+    return false;
+  }
+
+  int64_t start = esp_timer_get_time();
+  FSIZE_t position = f_tell(&log_file->file);
+
+  UINT written;
+  FRESULT res = f_write(&log_file->file, data, length, &written);
+  if (res == FR_OK) {
+    res = f_sync(&log_file->file);
+  }
+
+  log_file_record_latency(log_file, esp_timer_get_time() - start);
+  log_file_account(log_file);
+
+  if (res != FR_OK || written != length) {
+    ESP_LOGE(TAG, "Failed to write log %d", res);
+    f_lseek(&log_file->file, position);
+    return false;
+  }
+  return true;
+}
+
+uint32_t log_file_latency_percentile_us(struct LogFile *log_file, uint8_t percentile) {
+  uint32_t target = (log_file->writes * percentile + 99) / 100;
+  uint32_t count = 0;
+  uint32_t limit_us = 1000;
+
+  for (uint8_t i = 0; i < LOG_FILE_LATENCY_BUCKETS - 1; i++) {
+    count += log_file->latency_histogram[i];
+    if (count >= target) {
+      return limit_us;
+    }
+    limit_us <<= 1;
+  }
+  return log_file->max_latency_us;
+}
+
+// Cuts the unused part of the preallocated run off before closing
+void log_file_close(struct LogFile *log_file) {
+  if (!log_file->is_open) {
+    return;
+  }
+
+  FRESULT res = f_truncate(&log_file->file);
+  if (res != FR_OK) {
+    ESP_LOGE(TAG, "Failed to truncate log %d", res);
+  }
+  log_file_account(log_file);
+  f_close(&log_file->file);
+  log_file->is_open = false;
+
+  ESP_LOGI(TAG, "%d writes, latency p50 < %d us p99 < %d us max %d us, contiguous %d", log_file->writes,
+           log_file_latency_percentile_us(log_file, 50), log_file_latency_percentile_us(log_file, 99),
+           log_file->max_latency_us, log_file->is_contiguous);
+}
@@ -0,0 +1,30 @@
+#ifndef log_file_h
+#define log_file_h
+
+#include "ff.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// About 120 B/s of ride log, 1 MiB covers a bit more than two hours before the chain has to grow. Only files that
+// log_journal truncates at boot are preallocated, anything else would keep stale clusters after a reset
+#define LOG_FILE_PREALLOCATE_SIZE (1024 * 1024)
+#define LOG_FILE_LATENCY_BUCKETS 12
+
+struct LogFile {
+  FIL file;
+  bool is_open;
+  bool is_contiguous;
+  uint32_t clusters;
+  uint32_t writes;
+  uint32_t max_latency_us;
+  uint32_t latency_histogram[LOG_FILE_LATENCY_BUCKETS];
+};
+
+bool log_file_open(struct LogFile *log_file, const char *name, uint32_t preallocate_size);
+bool log_file_reopen(struct LogFile *log_file, const char *name);
+bool log_file_write(struct LogFile *log_file, const char *data, size_t length);
+void log_file_close(struct LogFile *log_file);
+uint32_t log_file_latency_percentile_us(struct LogFile *log_file, uint8_t percentile);
+
+#endif
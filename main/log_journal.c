@@ -0,0 +1,185 @@
+#include "log_journal.h"
+#include "esp32/rom/crc.h"
+#include "esp_log.h"
+#include "ff.h"
+#include "freertos/FreeRTOS.h"
+#include "log_shard.h"
+#include "logger.h"
+#include "sd_writer.h"
+#include "state.h"
+#include <stddef.h>
+#include <string.h>
+
+static const char *TAG = "journal";
+
+// Filled on the logger task and copied under the lock by the writer task, which owns sequence
+static struct LogJournalRecord journal;
+static uint32_t updates = 0;
+static uint32_t sequence = 0;
+static bool is_write_queued = false;
+static portMUX_TYPE journal_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t log_journal_crc(struct LogJournalRecord *record) {
+  return crc32_le(0, (const uint8_t *)record, offsetof(struct LogJournalRecord, crc));
+}
+
+// Slots sit in separate sectors, a write torn by a reset can only damage the older record
+static void log_journal_write(struct LogJournalRecord *record) {
+  FIL file;
+
+  record->magic = LOG_JOURNAL_MAGIC;
+  record->sequence = ++sequence;
+  record->crc = log_journal_crc(record);
+
+  FRESULT res = f_open(&file, LOG_JOURNAL_LOCATION, FA_OPEN_ALWAYS | FA_WRITE);
+  if (res != FR_OK) {
+    ESP_LOGE(TAG, "Failed to open journal %d", res);
+    return;
+  }
+
+  UINT written;
+  res = f_lseek(&file, (record->sequence & 1) * LOG_JOURNAL_SLOT_SIZE);
+  if (res == FR_OK) {
+    res = f_write(&file, record, sizeof(struct LogJournalRecord), &written);
+  }
+  f_close(&file);
+
+  if (res != FR_OK) {
+    ESP_LOGE(TAG, "Failed to write journal %d", res);
+  }
+}
+
+// Runs on the writer task and persists whatever the journal holds by then, so queued updates coalesce
+static void log_journal_write_latest(void *context) {
+  struct LogJournalRecord record;
+
+  portENTER_CRITICAL(&journal_lock);
+  record = journal;
+  is_write_queued = false;
+  portEXIT_CRITICAL(&journal_lock);
+
+  log_journal_write(&record);
+}
+
+static void log_journal_queue_write() {
+  portENTER_CRITICAL(&journal_lock);
+  bool is_queued = is_write_queued;
+  is_write_queued = true;
+  portEXIT_CRITICAL(&journal_lock);
+
+  if (!is_queued) {
+    sd_writer_call(log_journal_write_latest, NULL);
+  }
+}
+
+// Returns the newest slot with a valid crc
+static bool log_journal_read(struct LogJournalRecord *result) {
+  struct LogJournalRecord slot;
+  FIL file;
+  UINT read;
+  bool found = false;
+
+  if (f_open(&file, LOG_JOURNAL_LOCATION, FA_READ) != FR_OK) {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < 2; i++) {
+    read = 0;
+    if (f_lseek(&file, i * LOG_JOURNAL_SLOT_SIZE) != FR_OK || f_read(&file, &slot, sizeof(slot), &read) != FR_OK ||
+        read != sizeof(slot)) {
+      continue;
+    }
+    if (slot.magic != LOG_JOURNAL_MAGIC || slot.crc != log_journal_crc(&slot)) {
+      continue;
+    }
+    if (!found || slot.sequence > result->sequence) {
+      *result = slot;
+      found = true;
+    }
+  }
+  f_close(&file);
+
+  return found;
+}
+
+void log_journal_open(const char *log_filename, uint32_t start_time, uint8_t backend) {
+  portENTER_CRITICAL(&journal_lock);
+  memset(&journal, 0, sizeof(journal));
+  journal.state = LOG_JOURNAL_OPEN;
+  journal.backend = backend;
+  journal.ride.start_time = start_time;
+  strlcpy(journal.ride.filename, strrchr(log_filename, '/') + 1, sizeof(journal.ride.filename));
+  portEXIT_CRITICAL(&journal_lock);
+  updates = 0;
+
+  log_journal_queue_write();
+}
+
+// Offset is what the writer has already synced, so truncating there always leaves whole lines. A write is queued
+// as soon as it advances, otherwise recovery would cut off lines synced since the last record; the ride totals
+// alone only go out every LOG_JOURNAL_INTERVAL updates
+void log_journal_update(uint32_t offset, uint32_t duration, float distance, float energy) {
+  portENTER_CRITICAL(&journal_lock);
+  bool has_advanced = offset != journal.offset;
+  journal.offset = offset;
+  journal.ride.duration = duration;
+  journal.ride.distance = distance;
+  journal.ride.energy = energy;
+  portEXIT_CRITICAL(&journal_lock);
+
+  if (++updates % LOG_JOURNAL_INTERVAL == 0 || has_advanced) {
+    updates = 0;
+    log_journal_queue_write();
+  }
+}
+
+// Written after everything already queued for the writer task, so the session only counts as closed once its
+// files are
+void log_journal_close() {
+  portENTER_CRITICAL(&journal_lock);
+  journal.state = LOG_JOURNAL_CLOSED;
+  portEXIT_CRITICAL(&journal_lock);
+
+  log_journal_queue_write();
+}
+
+// Closes a session cut short by a reset, only the journal and the end of the log file are touched.
+// Also loads the last sequence number so records written from now on supersede the old slots.
+void log_journal_recover() {
+  if (!log_journal_read(&journal)) {
+    return;
+  }
+  sequence = journal.sequence;
+  if (journal.state != LOG_JOURNAL_OPEN) {
+    return;
+  }
+
+  char name[LOG_SHARD_PATH_MAX];
+  log_shard_path(name, sizeof(name), LOGS_LOCATION, journal.ride.filename);
+  ESP_LOGI(TAG, "Recovering %s at %d", name, journal.offset);
+
+  if (journal.backend == LOG_BACKEND_RAW) {
+    char path[LOG_FILENAME_MAX];
+    snprintf(path, sizeof(path), "%s%s", BASE_LOCATION, name);
+    log_materialize(path, journal.ride.start_time);
+  } else {
+    FIL file;
+    FRESULT res = f_open(&file, name, FA_WRITE | FA_OPEN_EXISTING);
+    if (res == FR_OK) {
+      res = f_lseek(&file, journal.offset);
+      if (res == FR_OK) {
+        res = f_truncate(&file);
+      }
+      f_close(&file);
+    }
+    if (res != FR_OK) {
+      ESP_LOGE(TAG, "Failed to repair %s %d", name, res);
+    }
+  }
+
+  ride_index_append(&journal.ride);
+
+  // runs before the writer task is started
+  journal.state = LOG_JOURNAL_CLOSED;
+  log_journal_write(&journal);
+}
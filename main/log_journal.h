@@ -0,0 +1,31 @@
+#ifndef log_journal_h
+#define log_journal_h
+
+#include "ff.h"
+#include "ride_index.h"
+#include <stdint.h>
+
+#define LOG_JOURNAL_LOCATION "/session.jnl"
+#define LOG_JOURNAL_MAGIC 0x4C4E524A
+#define LOG_JOURNAL_INTERVAL 5
+#define LOG_JOURNAL_SLOT_SIZE FF_SS_SDCARD
+
+typedef enum { LOG_JOURNAL_CLOSED, LOG_JOURNAL_OPEN } log_journal_state_t;
+
+// Kept in two alternating slots, one sector each, so a torn write always leaves the previous record intact
+struct LogJournalRecord {
+  uint32_t magic;
+  uint32_t sequence;
+  uint8_t state;
+  uint8_t backend;
+  uint32_t offset;
+  struct RideIndexRecord ride;
+  uint32_t crc;
+} __attribute__((packed));
+
+void log_journal_open(const char *log_filename, uint32_t start_time, uint8_t backend);
+void log_journal_update(uint32_t offset, uint32_t duration, float distance, float energy);
+void log_journal_close();
+void log_journal_recover();
+
+#endif
@@ -0,0 +1,47 @@
+#include "log_record.h"
+#include "state.h"
+#include <stdio.h>
+#include <sys/time.h>
+
+void log_record_fill(struct LogRecord *record) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+
+  record->riding_time = state_get()->riding_time;
+  record->timestamp = now.tv_sec;
+  record->latitude = state_get()->latitude.value;
+  record->longitude = state_get()->longitude.value;
+  record->speed = state_get()->speed.value;
+  record->voltage = state_get()->voltage.value;
+  record->current = state_get()->current.value;
+  record->used_energy = state_get()->used_energy.value;
+  record->total_energy = state_get()->total_energy.value;
+  record->trip_distance = state_get()->trip_distance.value;
+  record->altitude = state_get()->altitude.value;
+  record->state_of_charge = state_get()->state_of_charge.value;
+  record->range = state_get()->range.value;
+}
+
+void log_record_file_header(struct LogRecordFileHeader *header) {
+  header->magic = LOG_RECORD_FILE_MAGIC;
+  header->version = LOG_RECORD_FILE_VERSION;
+  header->record_size = sizeof(struct LogRecord);
+}
+
+int log_record_format(const struct LogRecord *record, char *line, size_t len) {
+  return snprintf(line, len, "%d,%d,%f,%f,%f,%f,%f,%f,%f,%f,%f,%.1f,%.1f\n", record->riding_time, record->timestamp,
+                  record->latitude, record->longitude, record->speed, record->voltage, record->current,
+                  record->used_energy, record->total_energy, record->trip_distance, record->altitude,
+                  record->state_of_charge, record->range);
+}
+
+// Same columns as LOG_RECORD_HEADER, one object per line
+int log_record_format_json(const struct LogRecord *record, char *line, size_t len) {
+  return snprintf(line, len,
+                  "{\"esp_log_timestamp\":%d,\"timestamp\":%d,\"latitude\":%f,\"longitude\":%f,\"speed\":%f,"
+                  "\"voltage\":%f,\"current\":%f,\"used_energy\":%f,\"total_energy\":%f,\"trip_distance\":%f,"
+                  "\"altitude\":%f,\"state_of_charge\":%.1f,\"range\":%.1f}\n",
+                  record->riding_time, record->timestamp, record->latitude, record->longitude, record->speed,
+                  record->voltage, record->current, record->used_energy, record->total_energy, record->trip_distance,
+                  record->altitude, record->state_of_charge, record->range);
+}
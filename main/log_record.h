@@ -0,0 +1,45 @@
+#ifndef log_record_h
+#define log_record_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_RECORD_HEADER                                                                                              \
+  "esp_log_timestamp,timestamp,latitude,longitude,speed,voltage,current,used_energy,total_energy,trip_distance,"      \
+  "altitude,state_of_charge,range\n"
+
+// Binary snapshot of one log line, fixed size so it can be stored without formatting on the hot path
+struct LogRecord {
+  uint32_t riding_time;
+  uint32_t timestamp;
+  double latitude;
+  double longitude;
+  float speed;
+  float voltage;
+  float current;
+  float used_energy;
+  float total_energy;
+  float trip_distance;
+  float altitude;
+  float state_of_charge;
+  float range;
+} __attribute__((packed));
+
+#define LOG_RECORD_FILE_MAGIC 0x43455252
+#define LOG_RECORD_FILE_VERSION 1
+#define LOG_RECORD_LINE_MAX 320
+
+// Leads a binary log file, followed by records of record_size bytes. Readers copy at most sizeof(struct LogRecord)
+// so files written with a longer record stay readable
+struct LogRecordFileHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+} __attribute__((packed));
+
+void log_record_fill(struct LogRecord *record);
+void log_record_file_header(struct LogRecordFileHeader *header);
+int log_record_format(const struct LogRecord *record, char *line, size_t len);
+int log_record_format_json(const struct LogRecord *record, char *line, size_t len);
+
+#endif
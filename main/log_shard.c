@@ -0,0 +1,115 @@
+#include "log_shard.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "log_shard";
+
+// Year and month come from the start time in the name, <prefix>.<year>.<month>.<day>..., month counted from 0
+static bool log_shard_parse(const char *filename, int *year, int *month) {
+  const char *start = strchr(filename, '.');
+  return start != NULL && sscanf(start, ".%d.%d.", year, month) == 2;
+}
+
+// Logs live in <root>/<year>/<month>/ so no directory grows past one month of rides
+bool log_shard_path(char *path, size_t len, const char *root, const char *filename) {
+  int year, month;
+
+  if (!log_shard_parse(filename, &year, &month)) {
+    snprintf(path, len, "%s/%s", root, filename);
+    return false;
+  }
+
+  snprintf(path, len, "%s/%04d/%02d/%s", root, year, month + 1, filename);
+  return true;
+}
+
+bool log_shard_make_dirs(const char *root, const char *filename) {
+  char path[LOG_SHARD_PATH_MAX];
+  int year, month;
+
+  if (!log_shard_parse(filename, &year, &month)) {
+    return false;
+  }
+
+  snprintf(path, sizeof(path), "%s/%04d", root, year);
+  FRESULT res = f_mkdir(path);
+  if (res != FR_OK && res != FR_EXIST) {
+    ESP_LOGE(TAG, "Failed to create folder %s %d", path, res);
+    return false;
+  }
+
+  snprintf(path, sizeof(path), "%s/%04d/%02d", root, year, month + 1);
+  res = f_mkdir(path);
+  if (res != FR_OK && res != FR_EXIST) {
+    ESP_LOGE(TAG, "Failed to create folder %s %d", path, res);
+    return false;
+  }
+  return true;
+}
+
+static bool log_shard_walk_dir(const char *dir_path, uint8_t depth, log_shard_file_cb_t callback, void *context) {
+  char path[LOG_SHARD_PATH_MAX];
+  FILINFO file;
+  FF_DIR dir;
+  bool keep_going = true;
+
+  if (f_opendir(&dir, dir_path) != FR_OK) {
+    return true;
+  }
+
+  while (keep_going && f_readdir(&dir, &file) == FR_OK && file.fname[0] != 0) {
+    if (file.fattrib & AM_DIR) {
+      if (depth < 2) {
+        snprintf(path, sizeof(path), "%s/%s", dir_path, file.fname);
+        keep_going = log_shard_walk_dir(path, depth + 1, callback, context);
+      }
+    } else if (depth == 2) {
+      keep_going = callback(dir_path, &file, context);
+    }
+  }
+  f_closedir(&dir);
+
+  return keep_going;
+}
+
+// Calls back for every log in the year and month folders, stops early when the callback returns false
+bool log_shard_walk(const char *root, log_shard_file_cb_t callback, void *context) {
+  return log_shard_walk_dir(root, 0, callback, context);
+}
+
+// Moves logs left in the flat layout into their month folders, a no-op once the root holds only folders
+void log_shard_migrate(const char *root) {
+  char from[LOG_SHARD_PATH_MAX];
+  char to[LOG_SHARD_PATH_MAX];
+  FILINFO file;
+  FF_DIR dir;
+  uint32_t moved = 0;
+  bool has_more = true;
+
+  // renaming changes the directory being read, so restart the listing after every pass
+  while (has_more) {
+    has_more = false;
+    if (f_opendir(&dir, root) != FR_OK) {
+      return;
+    }
+
+    while (f_readdir(&dir, &file) == FR_OK && file.fname[0] != 0) {
+      if ((file.fattrib & AM_DIR) || !log_shard_make_dirs(root, file.fname)) {
+        continue;
+      }
+
+      snprintf(from, sizeof(from), "%s/%s", root, file.fname);
+      log_shard_path(to, sizeof(to), root, file.fname);
+      if (f_rename(from, to) == FR_OK) {
+        moved++;
+        has_more = true;
+      }
+    }
+    f_closedir(&dir);
+  }
+
+  if (moved > 0) {
+    ESP_LOGI(TAG, "Moved %d logs in %s into month folders", moved, root);
+  }
+}
@@ -0,0 +1,18 @@
+#ifndef log_shard_h
+#define log_shard_h
+
+#include "ff.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_SHARD_PATH_MAX 80
+
+typedef bool (*log_shard_file_cb_t)(const char *dir, FILINFO *file, void *context);
+
+bool log_shard_path(char *path, size_t len, const char *root, const char *filename);
+bool log_shard_make_dirs(const char *root, const char *filename);
+bool log_shard_walk(const char *root, log_shard_file_cb_t callback, void *context);
+void log_shard_migrate(const char *root);
+
+#endif
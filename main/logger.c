@@ -9,23 +9,40 @@
 #include "sdmmc_cmd.h"
 #include "state.h"
 
+#include "distance.h"
 #include "gps.h"
+#include "log_file.h"
+#include "log_journal.h"
+#include "log_record.h"
+#include "log_shard.h"
+#include "raw_log.h"
+#include "sd_writer.h"
+#include "storage_space.h"
+#include "ride_index.h"
+#include "ride_summary.h"
+#include "telemetry.h"
+#include "track.h"
 
 #include "esp32/pm.h"
 #include "esp_pm.h"
+#include "esp_timer.h"
 #include "math.h"
 #include "service_battery.h"
 #include "service_location.h"
 #include "service_settings.h"
 
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
 #include <sys/time.h>
 #include <time.h>
-
-#define d2r (M_PI / 180.0)
+#include <unistd.h>
 
 #define LOG_CHARGING_INTERVAL 1000
 #define NOT_ACTIVE_TIME_MS 1000 * 10
 #define LOG_INTERVAL 1000
+#define LOG_ENTRY_MAX 256
+#define LOG_MATERIALIZE_BUFFER 4096
 static const char *TAG = "SD";
 
 #define PIN_NUM_MISO 2
@@ -38,22 +55,77 @@ extern struct Settings settings;
 bool is_logger_running = false;
 bool is_charging_running = false;
 
+void log_format_filename(char *name, size_t len, time_t t) {
+  struct tm *time;
+  time = gmtime(&t);
+
+  snprintf(name, len, "log.%d.%02d.%02d.%02d.%02d.%02d.log", (time->tm_year + 1900), time->tm_mon, time->tm_mday,
+           time->tm_hour, time->tm_min, time->tm_sec);
+}
+
 void log_generate_filename(char *name) {
 
   struct timeval now;
   gettimeofday(&now, NULL);
 
-  time_t t = (time_t)now.tv_sec;
-  struct tm *time;
-  time = gmtime(&t);
+  char filename[RIDE_INDEX_FILENAME_MAX];
+  log_format_filename(filename, sizeof(filename), now.tv_sec);
 
-  sprintf(name, "%s/log.%d.%02d.%02d.%02d.%02d.%02d.log", BASE_LOCATION LOGS_LOCATION, (time->tm_year + 1900),
-          time->tm_mon, time->tm_mday, time->tm_hour, time->tm_min, time->tm_sec);
+  log_shard_make_dirs(LOGS_LOCATION, filename);
+  log_shard_path(name, LOG_FILENAME_MAX, BASE_LOCATION LOGS_LOCATION, filename);
 }
 
 void log_deinit_sd_card() { esp_vfs_fat_sdmmc_unmount(); }
 
+#ifdef CONFIG_ESK8PAL_SD_BENCHMARK
+#define BENCHMARK_SIZE (1024 * 1024)
+#define BENCHMARK_LOCATION BASE_LOCATION "/bench.tmp"
+
+void log_benchmark_sd_card() {
+  char *buffer = malloc(SD_WRITER_BUFFER_SIZE);
+  if (buffer == NULL) {
+    return;
+  }
+  memset(buffer, 0x55, SD_WRITER_BUFFER_SIZE);
+
+  FILE *f = fopen(BENCHMARK_LOCATION, "w");
+  if (f == NULL) {
+    free(buffer);
+    return;
+  }
+
+  int64_t start = esp_timer_get_time();
+  for (uint32_t i = 0; i < BENCHMARK_SIZE / SD_WRITER_BUFFER_SIZE; i++) {
+    fwrite(buffer, 1, SD_WRITER_BUFFER_SIZE, f);
+  }
+  fclose(f);
+  int64_t write_time = esp_timer_get_time() - start;
+
+  f = fopen(BENCHMARK_LOCATION, "r");
+  start = esp_timer_get_time();
+  while (f != NULL && fread(buffer, 1, SD_WRITER_BUFFER_SIZE, f) > 0) {
+  }
+  int64_t read_time = esp_timer_get_time() - start;
+  if (f != NULL) {
+    fclose(f);
+  }
+
+  unlink(BENCHMARK_LOCATION);
+  free(buffer);
+
+  ESP_LOGI(TAG, "Benchmark write %d KiB/s read %d KiB/s", (int)(BENCHMARK_SIZE * 1000000LL / 1024 / write_time),
+           (int)(BENCHMARK_SIZE * 1000000LL / 1024 / read_time));
+}
+#endif
+
 void log_init_sd_card() {
+  esp_vfs_fat_sdmmc_mount_config_t mount_config = {
+      .format_if_mount_failed = false, .max_files = 5, .allocation_unit_size = 16 * 1024};
+
+  sdmmc_card_t *card;
+  esp_err_t ret;
+
+#ifdef CONFIG_ESK8PAL_SD_BUS_SPI
   ESP_LOGI(TAG, "Using SPI peripheral");
   spi_bus_config_t bus_cfg =
    {
@@ -62,7 +134,7 @@ void log_init_sd_card() {
        .sclk_io_num = PIN_NUM_CLK,
        .quadwp_io_num = -1,
        .quadhd_io_num = -1,
-       .max_transfer_sz = 4000
+       .max_transfer_sz = SD_WRITER_BUFFER_SIZE
    };
 
    spi_bus_initialize(HSPI_HOST,&bus_cfg,1);
@@ -73,11 +145,25 @@ void log_init_sd_card() {
   slot_config.gpio_cs = PIN_NUM_CS;
   slot_config.host_id = SPI2_HOST;
 
-  esp_vfs_fat_sdmmc_mount_config_t mount_config = {
-      .format_if_mount_failed = false, .max_files = 5, .allocation_unit_size = 16 * 1024};
-
-  sdmmc_card_t *card;
-  esp_err_t ret = esp_vfs_fat_sdspi_mount("/sdcard", &host, &slot_config, &mount_config, &card);
+  ret = esp_vfs_fat_sdspi_mount("/sdcard", &host, &slot_config, &mount_config, &card);
+#else
+  ESP_LOGI(TAG, "Using SDMMC peripheral");
+  sdmmc_host_t host = SDMMC_HOST_DEFAULT();
+#ifdef CONFIG_ESK8PAL_SD_HIGH_SPEED
+  host.max_freq_khz = SDMMC_FREQ_HIGHSPEED;
+#endif
+
+  sdmmc_slot_config_t slot_config = SDMMC_SLOT_CONFIG_DEFAULT();
+#ifdef CONFIG_ESK8PAL_SD_BUS_SDMMC_1BIT
+  slot_config.width = 1;
+#else
+  slot_config.width = 4;
+#endif
+  // internal pull-ups only help on short traces, the board should still have external ones
+  slot_config.flags |= SDMMC_SLOT_FLAG_INTERNAL_PULLUP;
+
+  ret = esp_vfs_fat_sdmmc_mount("/sdcard", &host, &slot_config, &mount_config, &card);
+#endif
 
   if (ret != ESP_OK) {
     if (ret == ESP_FAIL) {
@@ -93,25 +179,16 @@ void log_init_sd_card() {
   }
 
   sdmmc_card_print_info(stdout, card);
+
+#ifdef CONFIG_ESK8PAL_SD_BENCHMARK
+  log_benchmark_sd_card();
+#endif
 }
 
+// Publishes the cached value, storage_space keeps it current without walking the FAT
 void log_update_free_space() {
-  FATFS *fs;
-  DWORD fre_clust, fre_sect, tot_sect;
-
-  FRESULT res = f_getfree("/sdcard/", &fre_clust, &fs);
-  if (res) {
-    return;
-  }
-
-  tot_sect = (fs->n_fatent - 2) * fs->csize;
-  fre_sect = fre_clust * fs->csize;
-
-  uint64_t tmp_total_bytes = (uint64_t)tot_sect * FF_SS_SDCARD;
-  uint64_t tmp_free_bytes = (uint64_t)fre_sect * FF_SS_SDCARD;
-
-  state_get()->free_storage = tmp_free_bytes / (1024 * 1024);
-  state_get()->total_storage = tmp_total_bytes / (1024 * 1024);
+  state_get()->free_storage = storage_space_free_mb();
+  state_get()->total_storage = storage_space_total_mb();
 
   settings_set_value(IDX_CHAR_VAL_FREE_STORAGE, 4, (uint8_t *)&state_get()->free_storage);
   settings_set_value(IDX_CHAR_VAL_TOTAL_STORAGE, 4, (uint8_t *)&state_get()->total_storage);
@@ -119,89 +196,71 @@ void log_update_free_space() {
   ESP_LOGI(TAG, "Free space %d/%d", state_get()->free_storage, state_get()->total_storage);
 }
 
-void log_add_header(char *name) {
-  FILE *f = fopen(name, "a");
-  if (f == NULL) {
-    ESP_LOGE(TAG, "Failed to open file for writing %s", name);
-    log_init_sd_card();
-    return;
-  }
-
-  fprintf(f, "esp_log_timestamp,timestamp,latitude,longitude,speed,voltage,current,used_energy,total_energy,trip_"
-             "distance,altitude\n");
-
-  fclose(f);
+void log_add_header(struct SdWriterStream *stream) {
+  sd_writer_append(stream, LOG_RECORD_HEADER, strlen(LOG_RECORD_HEADER));
 }
 
-void log_add_entry(char *name) {
-  FILE *f = fopen(name, "a");
-  if (f == NULL) {
-    ESP_LOGE(TAG, "Failed to open file for writing %s", name);
-    log_init_sd_card();
-    return;
-  }
+// Queued for the writer task, entries are batched until the stream is due for a flush. Lines lost while a failed
+// file was closed are gone, the log continues after the last line that made it to the card
+void log_add_entry(struct SdWriterStream *stream, struct LogRecord *record) {
+  char line[LOG_ENTRY_MAX];
+  int length = log_record_format(record, line, sizeof(line));
 
-  struct timeval now;
-  gettimeofday(&now, NULL);
+  ESP_LOGI(TAG, "%.*s", length - 1, line);
 
-  fprintf(f, "%d,%ld,%f,%f,%f,%f,%f,%f,%f,%f,%f\n", state_get()->riding_time, now.tv_sec, state_get()->latitude.value,
-          state_get()->longitude.value, state_get()->speed.value, state_get()->voltage.value,
-          state_get()->current.value, state_get()->used_energy.value, state_get()->total_energy.value,
-          state_get()->trip_distance.value, state_get()->altitude.value);
-
-  ESP_LOGI(TAG, "%d,%ld,%f,%f,%f,%f,%f,%f,%f,%f,%f", state_get()->riding_time, now.tv_sec, state_get()->latitude.value,
-           state_get()->longitude.value, state_get()->speed.value, state_get()->voltage.value,
-           state_get()->current.value, state_get()->used_energy.value, state_get()->total_energy.value,
-           state_get()->trip_distance.value, state_get()->altitude.value);
-
-  fclose(f);
+  sd_writer_reopen_if_failed(stream);
+  sd_writer_append(stream, line, MIN(length, sizeof(line) - 1));
+  sd_writer_flush_if_due(stream);
 }
 
-double haversine_km(double lat1, double long1, double lat2, double long2) {
-  double dlong = (long2 - long1) * d2r;
-  double dlat = (lat2 - lat1) * d2r;
-  double a = pow(sin(dlat / 2.0), 2) + cos(lat1 * d2r) * cos(lat2 * d2r) * pow(sin(dlong / 2.0), 2);
-  double c = 2 * atan2(sqrt(a), sqrt(1 - a));
-  double d = 6367 * c;
-
-  return d;
+// Compact encoding, the records are stored as they are and turned into csv only when read back
+void log_add_binary_header(struct SdWriterStream *stream) {
+  struct LogRecordFileHeader header;
+  log_record_file_header(&header);
+  sd_writer_append(stream, &header, sizeof(header));
 }
 
-double haversine_mi(double lat1, double long1, double lat2, double long2) {
-  double dlong = (long2 - long1) * d2r;
-  double dlat = (lat2 - lat1) * d2r;
-  double a = pow(sin(dlat / 2.0), 2) + cos(lat1 * d2r) * cos(lat2 * d2r) * pow(sin(dlong / 2.0), 2);
-  double c = 2 * atan2(sqrt(a), sqrt(1 - a));
-  double d = 3956 * c;
-
-  return d;
+void log_add_binary_entry(struct SdWriterStream *stream, struct LogRecord *record) {
+  sd_writer_reopen_if_failed(stream);
+  sd_writer_append(stream, record, sizeof(struct LogRecord));
+  sd_writer_flush_if_due(stream);
 }
 
-void log_track_task() {
-  TickType_t xLastWakeTime = xTaskGetTickCount();
-  uint16_t measure_interval = 3000; // TODO add changing it based on current speed ?
-
-  while (state_get()->gps_fix_status != 1) {
-    vTaskDelayUntil(&xLastWakeTime, measure_interval / portTICK_PERIOD_MS);
-  }
-
-  double pLatitude = state_get()->latitude.value;
-  double pLongtitude = state_get()->longitude.value;
+struct LogMaterializeContext {
+  struct LogFile file;
+  char buffer[LOG_MATERIALIZE_BUFFER];
+  size_t length;
+};
 
-  vTaskDelayUntil(&xLastWakeTime, measure_interval / portTICK_PERIOD_MS);
+static struct LogMaterializeContext materialize_context;
 
-  double chunk;
+static void log_materialize_record(const void *record, void *context) {
+  struct LogMaterializeContext *ctx = context;
 
-  while (1) {
-    chunk = haversine_km(pLatitude, pLongtitude, state_get()->latitude.value, state_get()->longitude.value);
+  if (ctx->length + LOG_ENTRY_MAX > sizeof(ctx->buffer)) {
+    log_file_write(&ctx->file, ctx->buffer, ctx->length);
+    ctx->length = 0;
+  }
 
-    pLatitude = state_get()->latitude.value;
-    pLongtitude = state_get()->longitude.value;
+  int length = log_record_format(record, ctx->buffer + ctx->length, LOG_ENTRY_MAX);
+  ctx->length += MIN(length, LOG_ENTRY_MAX - 1);
+}
 
-    location_update_value(state_get()->trip_distance.value + chunk, IDX_CHAR_VAL_TRIP_DISTANCE, false);
+// Converts a ride kept in the raw partition into the regular csv log the uploader and file server expect
+void log_materialize(char *name, uint32_t session) {
+  if (!log_file_open(&materialize_context.file, name, LOG_FILE_PREALLOCATE_SIZE)) {
+    return;
+  }
+  log_file_write(&materialize_context.file, LOG_RECORD_HEADER, strlen(LOG_RECORD_HEADER));
 
-    vTaskDelayUntil(&xLastWakeTime, measure_interval / portTICK_PERIOD_MS);
+  materialize_context.length = 0;
+  uint32_t records = raw_log_read_session(session, log_materialize_record, &materialize_context);
+  if (materialize_context.length > 0) {
+    log_file_write(&materialize_context.file, materialize_context.buffer, materialize_context.length);
   }
+
+  log_file_close(&materialize_context.file);
+  ESP_LOGI(TAG, "Materialized %d records of session %d to %s", records, session, name);
 }
 
 time_t log_get_current_time() {
@@ -213,9 +272,30 @@ time_t log_get_current_time() {
 
 bool log_is_logger_running() { return is_logger_running; }
 
+// Runs on the writer task after the ride's files, the summary and index are written outside log_file and aren't
+// counted by it
+static void log_append_to_index(void *context) {
+  ride_index_append(context);
+  storage_space_invalidate();
+}
+
+// Like the summary, the record is only replaced by the next ride after its sd_writer_close drained the queue
+void log_add_to_index(char *name) {
+  static struct RideIndexRecord record;
+  struct RideSummary *summary = ride_summary_get();
+
+  memset(&record, 0, sizeof(record));
+  record.start_time = summary->start_time;
+  record.duration = summary->duration;
+  record.distance = summary->distance;
+  record.energy = summary->energy;
+  strlcpy(record.filename, strrchr(name, '/') + 1, sizeof(record.filename));
+
+  sd_writer_call(log_append_to_index, &record);
+}
+
 void log_task(void *params) {
   log_update_free_space();
-  TaskHandle_t trackTaskHandle;
 
   esp_err_t ret;
 
@@ -235,30 +315,64 @@ void log_task(void *params) {
 
     esp_pm_lock_acquire(pm_lock);
 
-    char log_filename[60];
+    char log_filename[LOG_FILENAME_MAX];
     log_generate_filename(log_filename);
 
-    log_add_header(log_filename);
+    time_t start_time = log_get_current_time();
+
+    // The raw partition skips FAT and formatting while riding, the csv file is written once the ride ends
+    bool use_raw_log = settings.log_backend == LOG_BACKEND_RAW && raw_log_is_available();
+    bool use_binary_log = settings.log_backend == LOG_BACKEND_BINARY;
+    struct SdWriterStream log_stream;
+    struct LogRecord record;
+
+    if (use_raw_log) {
+      raw_log_begin(start_time, sizeof(struct LogRecord));
+    } else if (use_binary_log) {
+      sd_writer_open(&log_stream, log_filename, LOG_FILE_PREALLOCATE_SIZE);
+      log_add_binary_header(&log_stream);
+    } else {
+      sd_writer_open(&log_stream, log_filename, LOG_FILE_PREALLOCATE_SIZE);
+      log_add_header(&log_stream);
+    }
+    log_journal_open(log_filename, start_time,
+                     use_raw_log ? LOG_BACKEND_RAW : (use_binary_log ? LOG_BACKEND_BINARY : LOG_BACKEND_FAT));
+    track_start(log_filename);
+    telemetry_start(log_filename);
 
     ESP_LOGI(TAG, "Start log %s", log_filename);
     uint32_t not_active_start_time = 0;
     state_set_device_state(STATE_RIDING);
     log_update_free_space();
 
-    xTaskCreate(log_track_task, "log_track_task", 1024 * 2, NULL, configMAX_PRIORITIES - 1, &trackTaskHandle);
-
+    distance_reset();
     location_update_value(0, IDX_CHAR_VAL_TRIP_DISTANCE, false);
 
     state_update();
 
     gps_disable_power_saving_mode();
 
-    time_t start_time = log_get_current_time();
+    ride_summary_start(start_time);
 
     while (1) {
       state_get()->riding_time = log_get_current_time() - start_time;
 
-      log_add_entry(log_filename);
+      log_record_fill(&record);
+      if (use_raw_log) {
+        raw_log_append(&record);
+      } else if (use_binary_log) {
+        log_add_binary_entry(&log_stream, &record);
+      } else {
+        log_add_entry(&log_stream, &record);
+      }
+      ride_summary_add_sample(log_get_current_time());
+      log_journal_update(use_raw_log ? 0 : __atomic_load_n(&log_stream.written, __ATOMIC_ACQUIRE),
+                         state_get()->riding_time, state_get()->trip_distance.value, ride_summary_get()->energy);
+      telemetry_flush();
+
+      if (state_get()->gps_fix_status > 0) {
+        track_add_point(log_get_current_time(), state_get()->latitude.value, state_get()->longitude.value);
+      }
 
       if (!state_is_in_driving_state()) {
         if (not_active_start_time == 0 && !settings.manual_ride_start) {
@@ -272,12 +386,24 @@ void log_task(void *params) {
       vTaskDelay(LOG_INTERVAL / portTICK_PERIOD_MS);
     }
     state_set_device_state(STATE_PARKED);
+    telemetry_finish();
+
+    if (use_raw_log) {
+      raw_log_end();
+      log_materialize(log_filename, start_time);
+    } else {
+      sd_writer_close(&log_stream);
+    }
+
+    struct TrackSummary track_summary;
+    track_finish(&track_summary);
+    ride_summary_finish(&track_summary);
+    log_add_to_index(log_filename);
+    log_journal_close();
     log_update_free_space();
 
     gps_enable_power_saving_mode();
 
-    vTaskDelete(trackTaskHandle);
-
     state_update();
 
     ESP_LOGI(TAG, "End log");
@@ -300,6 +426,25 @@ void log_init() {
     ESP_LOGE(TAG, "Failed to create folder %s %d", SYNCED_LOGS_LOCATION, res);
   }
 
+  res = f_mkdir(TRACKS_LOCATION);
+  if (res != FR_OK && res != FR_EXIST) {
+    ESP_LOGE(TAG, "Failed to create folder %s %d", TRACKS_LOCATION, res);
+  }
+
+  res = f_mkdir(TELEMETRY_LOCATION);
+  if (res != FR_OK && res != FR_EXIST) {
+    ESP_LOGE(TAG, "Failed to create folder %s %d", TELEMETRY_LOCATION, res);
+  }
+
+  log_shard_migrate(LOGS_LOCATION);
+  log_shard_migrate(SYNCED_LOGS_LOCATION);
+
+  storage_space_init();
+  ride_index_init();
+  raw_log_init();
+  log_journal_recover();
+  sd_writer_init();
+
   xTaskCreate(log_task, "logger_task", 1024 * 6, NULL, configMAX_PRIORITIES, NULL);
 }
 
@@ -312,8 +457,12 @@ void log_generate_filename_for_charging_log(char *name) {
   struct tm *time;
   time = gmtime(&t);
 
-  sprintf(name, "%s/charge.%d.%02d.%02d.%02d.%02d.%02d.log", BASE_LOCATION LOGS_LOCATION, (time->tm_year + 1900),
-          time->tm_mon, time->tm_mday, time->tm_hour, time->tm_min, time->tm_sec);
+  char filename[RIDE_INDEX_FILENAME_MAX];
+  snprintf(filename, sizeof(filename), "charge.%d.%02d.%02d.%02d.%02d.%02d.log", (time->tm_year + 1900), time->tm_mon,
+           time->tm_mday, time->tm_hour, time->tm_min, time->tm_sec);
+
+  log_shard_make_dirs(LOGS_LOCATION, filename);
+  log_shard_path(name, LOG_FILENAME_MAX, BASE_LOCATION LOGS_LOCATION, filename);
 }
 
 bool log_is_charging_running() { return is_charging_running; }
@@ -324,9 +473,13 @@ void log_charging_task(void *params) {
 
   is_charging_running = true;
 
-  char log_filename[60];
-  log_generate_filename(log_filename);
-  log_add_header(log_filename);
+  char log_filename[LOG_FILENAME_MAX];
+  log_generate_filename_for_charging_log(log_filename);
+
+  // not journaled, a preallocated file cut short by a reset would keep stale clusters past the last line
+  struct SdWriterStream log_stream;
+  sd_writer_open(&log_stream, log_filename, 0);
+  log_add_header(&log_stream);
 
   ESP_LOGI(TAG, "Start charging log %s", log_filename);
 
@@ -337,7 +490,9 @@ void log_charging_task(void *params) {
   while (1) {
     state_get()->riding_time = log_get_current_time() - start_time;
 
-    log_add_entry(log_filename);
+    struct LogRecord record;
+    log_record_fill(&record);
+    log_add_entry(&log_stream, &record);
 
     if (!state_is_in_charging_state()) {
       break;
@@ -345,6 +500,7 @@ void log_charging_task(void *params) {
     state_update();
     vTaskDelay(LOG_CHARGING_INTERVAL / portTICK_PERIOD_MS);
   }
+  sd_writer_close(&log_stream);
   log_update_free_space();
 
   state_update();
@@ -2,13 +2,21 @@
 #define logger_h
 
 #include "state.h"
+#include <stddef.h>
+#include <time.h>
 
 #define BASE_LOCATION "/sdcard"
 
 #define LOGS_LOCATION "/logs"
 #define SYNCED_LOGS_LOCATION "/logs-synced"
+#define TRACKS_LOCATION "/tracks"
+#define TELEMETRY_LOCATION "/telemetry"
+
+#define LOG_FILENAME_MAX 80
 
 void log_init();
+void log_format_filename(char *name, size_t len, time_t t);
+void log_materialize(char *name, uint32_t session);
 void log_init_sd_card();
 bool log_is_logger_running();
 
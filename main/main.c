@@ -35,8 +35,11 @@
 #include <time.h>
 
 #include "activity_detector.h"
+#include "battery_soc.h"
+#include "current_calibration.h"
 #include "esp_sleep.h"
 #include "power.h"
+#include "sync_scheduler.h"
 #include "uploader.h"
 
 static const char *TAG = "main";
@@ -82,14 +85,6 @@ bool can_go_to_sleep() {
          !is_battery_service_connected() && !log_is_charging_running() && wifi_get_state() == WIFI_DISABLED;
 }
 
-bool should_start_uploader_task(const int64_t *last_upload_attempt) {
-  uint16_t files_to_be_uploaded = uploader_count_files_to_be_uploaded();
-  bool is_attempt_allowed =
-      (esp_timer_get_time() - *last_upload_attempt) > (settings.upload_interval * 60 * 1000 * 1000);
-
-  return files_to_be_uploaded > 0 && !uploader_is_task_running() && is_attempt_allowed;
-}
-
 void update_battery_details() {
   power_up_module();
 
@@ -97,26 +92,29 @@ void update_battery_details() {
   double current = read_current_short();
   battery_update_value(voltage, IDX_CHAR_VAL_VOLTAGE, false);
   battery_update_value(current, IDX_CHAR_VAL_CURRENT, false);
+  soc_update(voltage * 1000, current * 1000);
+  soc_publish();
 
   //ESP_LOGI(TAG, "voltage %f, current %f", voltage, current);
   detect_activity(current);
 
+  if (state_get_device_state() == STATE_PARKED && calibration_is_due()) {
+    calibrate_current_sensor();
+  }
+
   power_down_module();
 }
 
 void main_task() {
   TickType_t xLastWakeTime = xTaskGetTickCount();
 
-  int64_t last_upload_attempt = 0;
   gpio_pad_select_gpio(GPIO_NUM_22);
   gpio_set_direction(GPIO_NUM_22, GPIO_MODE_OUTPUT);
 
   while (1) {
     if (!state_is_in_driving_state() && !state_is_in_charging_state()) {
 
-      if (should_start_uploader_task(&last_upload_attempt)) {
-        last_upload_attempt = esp_timer_get_time();
-
+      if (sync_scheduler_should_start()) {
         xTaskCreate(uploader_sync, "uploader_sync", 1024 * 6, NULL, configMAX_PRIORITIES, NULL);
         vTaskDelayUntil(&xLastWakeTime, 1000 / portTICK_PERIOD_MS);
       }
@@ -167,6 +165,7 @@ void app_main(void) {
 
   app_init_time();
   settings_init();
+  soc_init(settings.battery_cells, settings.battery_capacity);
 
   ble_init();
   init_gps();
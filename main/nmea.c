@@ -0,0 +1,98 @@
+#include "nmea.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Copies field number index of a complete NMEA sentence, false when the field is missing, empty or too long
+bool nmea_get_field(const char *sentence, uint8_t index, char *field, size_t len) {
+  const char *start = sentence;
+
+  for (uint8_t i = 0; i < index; i++) {
+    start = strchr(start, ',');
+    if (start == NULL) {
+      return false;
+    }
+    start++;
+  }
+
+  size_t length = strcspn(start, ",*\r\n");
+  if (length == 0 || length >= len) {
+    return false;
+  }
+  memcpy(field, start, length);
+  field[length] = 0;
+  return true;
+}
+
+// XOR of everything between '$' and '*' has to match the two hex digits after '*'
+bool nmea_is_checksum_valid(const char *sentence) {
+  const char *end = strchr(sentence, '*');
+  if (sentence[0] != '$' || end == NULL || strlen(end) < 3) {
+    return false;
+  }
+
+  uint8_t checksum = 0;
+  for (const char *c = sentence + 1; c < end; c++) {
+    checksum ^= *c;
+  }
+
+  char expected[3] = {end[1], end[2], 0};
+  return checksum == strtoul(expected, NULL, 16);
+}
+
+// NMEA coordinates are (d)ddmm.mmmm
+static double nmea_parse_coordinate(const char *field, char hemisphere) {
+  double value = atof(field);
+  int degrees = (int)(value / 100);
+  double coordinate = degrees + (value - degrees * 100) / 60;
+
+  return hemisphere == 'S' || hemisphere == 'W' ? -coordinate : coordinate;
+}
+
+// $GNGLL,lat,N|S,lon,E|W,time,status,...
+bool nmea_get_location(const char *sentence, double *latitude, double *longitude) {
+  char lat[16], lat_ind[2], lon[16], lon_ind[2], status[2];
+
+  if (!nmea_get_field(sentence, 6, status, sizeof(status)) || status[0] != 'A' ||
+      !nmea_get_field(sentence, 1, lat, sizeof(lat)) || !nmea_get_field(sentence, 2, lat_ind, sizeof(lat_ind)) ||
+      !nmea_get_field(sentence, 3, lon, sizeof(lon)) || !nmea_get_field(sentence, 4, lon_ind, sizeof(lon_ind))) {
+    return false;
+  }
+
+  *latitude = nmea_parse_coordinate(lat, lat_ind[0]);
+  *longitude = nmea_parse_coordinate(lon, lon_ind[0]);
+  return true;
+}
+
+// $GNVTG,course,T,course_magnetic,M,speed_knots,N,speed_kmh,K,... course is empty while standing still,
+// course is only written when present
+bool nmea_get_speed(const char *sentence, double *speed, double *course) {
+  char field[12];
+
+  if (!nmea_get_field(sentence, 7, field, sizeof(field))) {
+    return false;
+  }
+  *speed = atof(field);
+
+  if (nmea_get_field(sentence, 1, field, sizeof(field))) {
+    *course = atof(field);
+  }
+  return true;
+}
+
+// $GNGGA,time,lat,N,lon,E,fix,satelites,hdop,altitude,... satelites and altitude are only written when present
+bool nmea_get_satelite_info(const char *sentence, uint8_t *fix, uint8_t *satelite_number, double *altitude) {
+  char field[12];
+
+  if (!nmea_get_field(sentence, 6, field, sizeof(field))) {
+    return false;
+  }
+  *fix = atoi(field);
+
+  if (nmea_get_field(sentence, 7, field, sizeof(field))) {
+    *satelite_number = atoi(field);
+  }
+  if (nmea_get_field(sentence, 9, field, sizeof(field))) {
+    *altitude = atof(field);
+  }
+  return true;
+}
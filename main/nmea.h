@@ -0,0 +1,15 @@
+#ifndef nmea_h
+#define nmea_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+bool nmea_get_field(const char *sentence, uint8_t index, char *field, size_t len);
+bool nmea_is_checksum_valid(const char *sentence);
+
+bool nmea_get_location(const char *sentence, double *latitude, double *longitude);
+bool nmea_get_speed(const char *sentence, double *speed, double *course);
+bool nmea_get_satelite_info(const char *sentence, uint8_t *fix, uint8_t *satelite_number, double *altitude);
+
+#endif
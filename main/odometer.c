@@ -0,0 +1,61 @@
+#include "odometer.h"
+#include <math.h>
+
+#define d2r (M_PI / 180.0)
+#define EARTH_RADIUS_KM 6367.0f
+
+// below this speed fixes are treated as GPS jitter around a standing position
+#define DISTANCE_MIN_SPEED_KMH 2.0
+// position has to move this far from the last anchor before a segment is counted
+#define DISTANCE_MIN_SEGMENT_KM 0.003
+// longer segments, e.g. after losing fix, fall back to the exact formula
+#define DISTANCE_MAX_EQUIRECTANGULAR_KM 10.0
+
+void odometer_reset(struct Odometer *odometer) { odometer->has_anchor = false; }
+
+double distance_equirectangular_km(double lat1, double long1, double lat2, double long2) {
+  float x = (float)((long2 - long1) * d2r) * cosf((float)((lat1 + lat2) * 0.5 * d2r));
+  float y = (float)((lat2 - lat1) * d2r);
+
+  return EARTH_RADIUS_KM * sqrtf(x * x + y * y);
+}
+
+double haversine_km(double lat1, double long1, double lat2, double long2) {
+  double dlong = (long2 - long1) * d2r;
+  double dlat = (lat2 - lat1) * d2r;
+  double a = pow(sin(dlat / 2.0), 2) + cos(lat1 * d2r) * cos(lat2 * d2r) * pow(sin(dlong / 2.0), 2);
+  double c = 2 * atan2(sqrt(a), sqrt(1 - a));
+  double d = EARTH_RADIUS_KM * c;
+
+  return d;
+}
+
+// Returns the distance to add to the trip, zero while standing or until the position moves far enough
+double odometer_add_fix(struct Odometer *odometer, double latitude, double longitude, double speed) {
+  if (!odometer->has_anchor) {
+    odometer->anchor_latitude = latitude;
+    odometer->anchor_longitude = longitude;
+    odometer->has_anchor = true;
+    return 0;
+  }
+
+  if (speed < DISTANCE_MIN_SPEED_KMH) {
+    return 0;
+  }
+
+  double chunk =
+      distance_equirectangular_km(odometer->anchor_latitude, odometer->anchor_longitude, latitude, longitude);
+
+  if (chunk < DISTANCE_MIN_SEGMENT_KM) {
+    return 0;
+  }
+
+  if (chunk > DISTANCE_MAX_EQUIRECTANGULAR_KM) {
+    chunk = haversine_km(odometer->anchor_latitude, odometer->anchor_longitude, latitude, longitude);
+  }
+
+  odometer->anchor_latitude = latitude;
+  odometer->anchor_longitude = longitude;
+
+  return chunk;
+}
@@ -0,0 +1,19 @@
+#ifndef odometer_h
+#define odometer_h
+
+#include <stdbool.h>
+
+// Last position a segment was counted from, fixes closer than the minimum segment are measured from here
+struct Odometer {
+  bool has_anchor;
+  double anchor_latitude;
+  double anchor_longitude;
+};
+
+void odometer_reset(struct Odometer *odometer);
+double odometer_add_fix(struct Odometer *odometer, double latitude, double longitude, double speed);
+
+double distance_equirectangular_km(double lat1, double long1, double lat2, double long2);
+double haversine_km(double lat1, double long1, double lat2, double long2);
+
+#endif
@@ -1,5 +1,7 @@
 #include "power.h"
 #include "activity_detector.h"
+#include "battery_soc.h"
+#include "current_calibration.h"
 #include "driver/adc.h"
 #include "driver/gpio.h"
 #include "esp_adc_cal.h"
@@ -8,109 +10,187 @@
 #include "service_battery.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 
 #include "ads1115/ads1115.h"
 #include "driver/i2c.h"
+#include "ds3231/ds3231.h"
+#include "filter.h"
+#include "esp_timer.h"
+#include "telemetry.h"
 
 #define VOLTAGE_DIVIDER 22.53
 #define CURRENT_SENSOR_SENSIVITY 0.026666666667
-#define AMPERE_PER_MS 1 / (60 * 60 * 1000)
+#define MILLIAMPERE_MS_PER_AMPERE_HOUR (60 * 60 * 1000 * 1000.0)
 #define CURRENT_NUM_SAMPLES 32
 
+#define ADC_FULL_SCALE 2.048
+#define ADC_COUNTS 32768
+#define SAMPLE_FRACTION_BITS 4
+#define MILLIAMPERE_PER_COUNT_Q16                                                                                      \
+  ((int64_t)(ADC_FULL_SCALE / ADC_COUNTS / CURRENT_SENSOR_SENSIVITY * 1000 * 65536 + 0.5))
+#define MILLIVOLT_PER_COUNT_Q16 ((int64_t)(ADC_FULL_SCALE / ADC_COUNTS * VOLTAGE_DIVIDER * 1000 * 65536 + 0.5))
+
+#define CURRENT_MEDIAN_SIZE 3
+#define CURRENT_LOW_PASS_SHIFT 2
+#define VOLTAGE_AVERAGE_SIZE 8
+
+#define CALIBRATION_MAX_SPREAD 0.002
+#define CALIBRATION_MAX_OFFSET 0.3
+#define TEMPERATURE_UPDATE_INTERVAL_MS (60 * 1000)
+// sd writer runs on the other core
+#define ADC_TASK_CORE 1
+
 ads1115_t ads;
 
-double zero = 1.622531;
+double zero = CALIBRATION_DEFAULT_ZERO;
+int32_t zero_counts = 0;
+float temperature = 0;
 
-double read_current() {
-  ads1115_set_mux(&ads, ADS1115_MUX_1_GND);
-  double current = 0;
-  for (uint8_t i = 0; i < CURRENT_NUM_SAMPLES; i++) {
-    current += ads1115_get_voltage(&ads);
-  }
+// one window per task, the ADC task samples every period while riding or charging and the main task once per
+// parked wake up, sharing a window would race and mix the two rates
+struct MedianFilter current_spike_filter;
+struct MedianFilter parked_current_spike_filter;
+struct LowPassFilter current_activity_filter;
+struct MovingAverageFilter voltage_filter;
 
-  return -((current / CURRENT_NUM_SAMPLES - zero) / CURRENT_SENSOR_SENSIVITY);
+void power_set_zero(double new_zero) {
+  zero = new_zero;
+  zero_counts = (int32_t)(zero * ADC_COUNTS / ADC_FULL_SCALE * (1 << SAMPLE_FRACTION_BITS));
 }
 
-double read_current_samples(uint16_t samples) {
+static int32_t read_current_filtered_ma(struct MedianFilter *spike_filter, uint16_t samples) {
   ads1115_set_mux(&ads, ADS1115_MUX_1_GND);
-  double current = 0;
-  for (uint8_t i = 0; i < samples; i++) {
-    current += ads1115_get_voltage(&ads);
+
+  // the window carries over between calls, so single sample reads are spike filtered too
+  int32_t sum = 0;
+  for (uint16_t i = 0; i < samples; i++) {
+    sum += filter_median_update(spike_filter, ads1115_get_raw(&ads));
   }
 
-  return -((current / samples - zero) / CURRENT_SENSOR_SENSIVITY);
+  int32_t average = sum * (1 << SAMPLE_FRACTION_BITS) / samples;
+  return -(((average - zero_counts) * MILLIAMPERE_PER_COUNT_Q16) >> (16 + SAMPLE_FRACTION_BITS));
 }
 
-double read_current_short() {
-  ads1115_set_mux(&ads, ADS1115_MUX_1_GND);
-  double current = ads1115_get_voltage(&ads);
-  return -((current - zero) / CURRENT_SENSOR_SENSIVITY);
+// ADC task only
+int32_t read_current_ma(uint16_t samples) { return read_current_filtered_ma(&current_spike_filter, samples); }
+
+int32_t read_voltage_mv() {
+  ads1115_set_mux(&ads, ADS1115_MUX_0_GND);
+  return (ads1115_get_raw(&ads) * MILLIVOLT_PER_COUNT_Q16) >> 16;
 }
 
-void calibrate_current_sensor() {
+// Main task only
+double read_current() { return read_current_filtered_ma(&parked_current_spike_filter, CURRENT_NUM_SAMPLES) / 1000.0; }
+
+double read_current_short() { return read_current_filtered_ma(&parked_current_spike_filter, 1) / 1000.0; }
+
+void power_update_temperature() {
+  if (ds3231_get_temp_float(&temperature) == ESP_OK) {
+    power_set_zero(calibration_get_zero(temperature));
+  }
+}
+
+bool calibrate_current_sensor() {
   ads1115_set_mux(&ads, ADS1115_MUX_1_GND);
   double current = 0;
-  for (uint8_t i = 0; i < 64; i++) {
-    current += ads1115_get_voltage(&ads);
+  double min = ads1115_get_voltage(&ads);
+  double max = min;
+
+  for (uint8_t i = 0; i < CALIBRATION_NUM_SAMPLES; i++) {
+    double sample = ads1115_get_voltage(&ads);
+    current += sample;
+    min = sample < min ? sample : min;
+    max = sample > max ? sample : max;
   }
-  ESP_LOGI("ADC", "curr %f", current / 64);
-  zero = current / 64;
-}
+  current = current / CALIBRATION_NUM_SAMPLES;
 
-double read_voltage() {
-  ads1115_set_mux(&ads, ADS1115_MUX_0_GND);
-  double voltage = ads1115_get_voltage(&ads);
-  return voltage * VOLTAGE_DIVIDER;
+  // any load on the sensor shows up as noise or as an offset far from the known zero
+  if (max - min > CALIBRATION_MAX_SPREAD ||
+      fabs(current - zero) / CURRENT_SENSOR_SENSIVITY > CALIBRATION_MAX_OFFSET) {
+    ESP_LOGI("ADC", "calibration skipped, sensor not idle %f %f", current, max - min);
+    return false;
+  }
+
+  if (ds3231_get_temp_float(&temperature) != ESP_OK) {
+    return false;
+  }
+
+  ESP_LOGI("ADC", "curr %f", current);
+  calibration_add_measurement(current, temperature);
+  power_set_zero(calibration_get_zero(temperature));
+  return true;
 }
 
+double read_voltage() { return read_voltage_mv() / 1000.0; }
+
 void read_adc_data() {
   TickType_t xLastWakeTime = xTaskGetTickCount();
 
-  double mah = 0;
-  double voltage = 0;
-  double current = 0;
+  int64_t used_charge = 0;
+  int32_t voltage = 0;
+  int32_t current = 0;
 
-  uint16_t measure_interval = 50;
+  uint16_t measure_interval = TELEMETRY_DEFAULT_INTERVAL_MS;
   uint16_t charge_measure_interval = 100;
 
   uint16_t ticks_per_second = 1000 / measure_interval;
   uint16_t iterator = 0;
+  uint16_t temperature_iterator = 0;
 
   while (1) {
     if (state_is_in_driving_state()) {
       power_up_module();
-      current = read_current();
-      mah += current * AMPERE_PER_MS * measure_interval;
+      measure_interval = telemetry_interval_ms();
+      ticks_per_second = 1000 / measure_interval;
+
+      // fewer samples per reading at higher rates so the conversions still fit in the period
+      current = read_current_ma(CURRENT_NUM_SAMPLES * measure_interval / TELEMETRY_DEFAULT_INTERVAL_MS);
+      used_charge += current * measure_interval;
+      if (telemetry_is_active() || telemetry_live_is_active()) {
+        telemetry_add_adc(esp_timer_get_time(), current, read_voltage_mv());
+      }
+      soc_update(voltage, current);
+      int32_t filtered_current = filter_low_pass_update(&current_activity_filter, current);
 
       if (iterator >= ticks_per_second / 2) {
         iterator = 0;
-        voltage = read_voltage();
-        battery_update_value(current, IDX_CHAR_VAL_CURRENT, false);
-        battery_update_value(voltage, IDX_CHAR_VAL_VOLTAGE, false);
-        battery_update_value(mah, IDX_CHAR_VAL_USED_ENERGY, false);
+        voltage = filter_moving_average_update(&voltage_filter, read_voltage_mv());
+        battery_update_value(current / 1000.0, IDX_CHAR_VAL_CURRENT, false);
+        battery_update_value(voltage / 1000.0, IDX_CHAR_VAL_VOLTAGE, false);
+        battery_update_value(used_charge / MILLIAMPERE_MS_PER_AMPERE_HOUR, IDX_CHAR_VAL_USED_ENERGY, false);
+        soc_publish();
 
-        detect_activity(current);
+        detect_activity(filtered_current / 1000.0);
+      }
+      if (temperature_iterator >= TEMPERATURE_UPDATE_INTERVAL_MS / measure_interval) {
+        temperature_iterator = 0;
+        power_update_temperature();
       }
       iterator++;
+      temperature_iterator++;
       vTaskDelayUntil(&xLastWakeTime, measure_interval / portTICK_PERIOD_MS);
     } else if (state_is_in_charging_state()) {
       power_up_module();
       iterator = 0;
 
-      current = read_current_samples(64);
-      mah += current * AMPERE_PER_MS * charge_measure_interval;
-      voltage = read_voltage();
+      current = read_current_ma(64);
+      used_charge += current * charge_measure_interval;
+      voltage = filter_moving_average_update(&voltage_filter, read_voltage_mv());
+      soc_update(voltage, current);
+      telemetry_add_adc(esp_timer_get_time(), current, voltage);
 
-      battery_update_value(current, IDX_CHAR_VAL_CURRENT, false);
-      battery_update_value(voltage, IDX_CHAR_VAL_VOLTAGE, false);
-      battery_update_value(mah, IDX_CHAR_VAL_USED_ENERGY, false);
+      battery_update_value(current / 1000.0, IDX_CHAR_VAL_CURRENT, false);
+      battery_update_value(voltage / 1000.0, IDX_CHAR_VAL_VOLTAGE, false);
+      battery_update_value(used_charge / MILLIAMPERE_MS_PER_AMPERE_HOUR, IDX_CHAR_VAL_USED_ENERGY, false);
+      soc_publish();
 
-      detect_activity(current);
+      detect_activity(filter_low_pass_update(&current_activity_filter, current) / 1000.0);
 
       vTaskDelayUntil(&xLastWakeTime, charge_measure_interval / portTICK_PERIOD_MS);
     } else {
       iterator = 0;
-      mah = 0;
+      used_charge = 0;
       vTaskDelayUntil(&xLastWakeTime, 1000 / portTICK_PERIOD_MS);
     }
   }
@@ -121,10 +201,22 @@ void power_down_module() { gpio_set_level(POWER_MODLE_GPIO, 1); }
 bool power_is_module_powered() { return gpio_get_level(POWER_MODLE_GPIO); }
 
 void power_sensor_init() {
+  calibration_init();
+  // the model is temperature dependent, the zero for 0C would be off until the first periodic update
+  if (ds3231_get_temp_float(&temperature) != ESP_OK) {
+    ESP_LOGE("ADC", "Failed to read temperature");
+  }
+  power_set_zero(calibration_get_zero(temperature));
+
+  filter_median_init(&current_spike_filter, CURRENT_MEDIAN_SIZE);
+  filter_median_init(&parked_current_spike_filter, CURRENT_MEDIAN_SIZE);
+  filter_low_pass_init(&current_activity_filter, CURRENT_LOW_PASS_SHIFT);
+  filter_moving_average_init(&voltage_filter, VOLTAGE_AVERAGE_SIZE);
+
   ads = ads1115_config(I2C_NUM_0, 0x48);
 
   ads1115_set_pga(&ads, ADS1115_FSR_2_048);
   ads1115_set_sps(&ads, ADS1115_SPS_860);
 
-  xTaskCreate(read_adc_data, "read_adc_data", 1024 * 4, NULL, configMAX_PRIORITIES, NULL);
+  xTaskCreatePinnedToCore(read_adc_data, "read_adc_data", 1024 * 4, NULL, configMAX_PRIORITIES, NULL, ADC_TASK_CORE);
 }
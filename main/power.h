@@ -2,6 +2,7 @@
 #define power_h
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #define POWER_MODLE_GPIO GPIO_NUM_27
 
@@ -14,6 +15,12 @@ double read_current();
 double read_current_short();
 double read_voltage();
 
+int32_t read_current_ma(uint16_t samples);
+int32_t read_voltage_mv();
+
+bool calibrate_current_sensor();
+void power_update_temperature();
+
 bool power_is_module_powered();
 
 #endif
\ No newline at end of file
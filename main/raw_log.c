@@ -0,0 +1,231 @@
+#include "raw_log.h"
+#include "esp32/rom/crc.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include <stddef.h>
+#include <string.h>
+
+static const char *TAG = "raw_log";
+
+#define RAW_LOG_PAYLOAD_SIZE (RAW_LOG_SECTOR_SIZE - sizeof(struct RawLogSectorHeader))
+
+static const esp_partition_t *partition = NULL;
+static uint32_t sector_count = 0;
+
+static uint32_t next_sector = 0;
+static uint32_t next_sequence = 0;
+
+static uint8_t sector_buffer[RAW_LOG_SECTOR_SIZE];
+static uint16_t sector_length = 0;
+static uint32_t current_session = 0;
+static uint16_t current_record_size = 0;
+static bool is_sector_writable = false;
+
+static uint32_t raw_log_crc(struct RawLogSectorHeader *header, const uint8_t *payload) {
+  uint32_t crc = header->crc;
+
+  header->crc = 0;
+  uint32_t result = crc32_le(0, (const uint8_t *)header, sizeof(struct RawLogSectorHeader));
+  result = crc32_le(result, payload, header->length);
+  header->crc = crc;
+
+  return result;
+}
+
+static uint32_t raw_log_sector_offset() { return next_sector * RAW_LOG_SECTOR_SIZE; }
+
+// Sectors are written strictly in ring order, so erasing just ahead of the write position spreads wear evenly.
+// Only the fields known up front are programmed here, length and crc stay erased until the sector is sealed
+static void raw_log_open_sector() {
+  struct RawLogSectorHeader header = {.magic = RAW_LOG_MAGIC,
+                                      .sequence = next_sequence,
+                                      .session = current_session,
+                                      .record_size = current_record_size};
+
+  uint32_t offset = raw_log_sector_offset();
+  esp_err_t err = esp_partition_erase_range(partition, offset, RAW_LOG_SECTOR_SIZE);
+  if (err == ESP_OK) {
+    err = esp_partition_write(partition, offset, &header, offsetof(struct RawLogSectorHeader, length));
+  }
+
+  is_sector_writable = err == ESP_OK;
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to open sector %d %s", next_sector, esp_err_to_name(err));
+  }
+}
+
+// Programs length and crc over the records already in flash, a sealed sector is checked as a whole when read back
+static void raw_log_seal_sector() {
+  if (sector_length == 0) {
+    return;
+  }
+
+  struct RawLogSectorHeader *header = (struct RawLogSectorHeader *)sector_buffer;
+  header->magic = RAW_LOG_MAGIC;
+  header->sequence = next_sequence;
+  header->session = current_session;
+  header->record_size = current_record_size;
+  header->length = sector_length;
+  header->crc = raw_log_crc(header, sector_buffer + sizeof(struct RawLogSectorHeader));
+
+  if (is_sector_writable) {
+    size_t seal_offset = offsetof(struct RawLogSectorHeader, length);
+    esp_err_t err = esp_partition_write(partition, raw_log_sector_offset() + seal_offset, sector_buffer + seal_offset,
+                                        sizeof(struct RawLogSectorHeader) - seal_offset);
+    if (err != ESP_OK) {
+      ESP_LOGE(TAG, "Failed to seal sector %d %s", next_sector, esp_err_to_name(err));
+    }
+  }
+
+  next_sector = (next_sector + 1) % sector_count;
+  next_sequence++;
+  sector_length = 0;
+}
+
+// Finds the newest sector from the headers only, payloads are checked when a session is read back
+bool raw_log_init() {
+  partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, RAW_LOG_PARTITION_LABEL);
+  if (partition == NULL) {
+    ESP_LOGI(TAG, "No %s partition, raw log disabled", RAW_LOG_PARTITION_LABEL);
+    return false;
+  }
+
+  sector_count = partition->size / RAW_LOG_SECTOR_SIZE;
+  next_sector = 0;
+  next_sequence = 0;
+  sector_length = 0;
+  is_sector_writable = false;
+
+  struct RawLogSectorHeader header;
+  bool found = false;
+
+  for (uint32_t sector = 0; sector < sector_count; sector++) {
+    if (esp_partition_read(partition, sector * RAW_LOG_SECTOR_SIZE, &header, sizeof(header)) != ESP_OK) {
+      continue;
+    }
+    if (header.magic != RAW_LOG_MAGIC) {
+      continue;
+    }
+    if (!found || header.sequence >= next_sequence) {
+      next_sequence = header.sequence + 1;
+      next_sector = (sector + 1) % sector_count;
+      found = true;
+    }
+  }
+
+  ESP_LOGI(TAG, "%d sectors, next sector %d sequence %d", sector_count, next_sector, next_sequence);
+  return true;
+}
+
+bool raw_log_is_available() { return partition != NULL; }
+
+// A session that was never ended still owns the open sector, it is sealed under its own session before the new one
+// starts on the next sector
+void raw_log_begin(uint32_t session, uint16_t record_size) {
+  if (partition != NULL) {
+    raw_log_seal_sector();
+  }
+
+  current_session = session;
+  current_record_size = record_size;
+  sector_length = 0;
+}
+
+// Records never straddle sectors, the tail of a sector that can't fit a whole record stays unused. Every record is
+// programmed as it arrives, a reset loses at most the one in flight; the copy in sector_buffer feeds the crc
+bool raw_log_append(const void *record) {
+  if (partition == NULL) {
+    return false;
+  }
+
+  if (sector_length + current_record_size > RAW_LOG_PAYLOAD_SIZE) {
+    raw_log_seal_sector();
+  }
+  if (sector_length == 0) {
+    raw_log_open_sector();
+  }
+
+  uint16_t position = sizeof(struct RawLogSectorHeader) + sector_length;
+  memcpy(sector_buffer + position, record, current_record_size);
+  sector_length += current_record_size;
+
+  if (!is_sector_writable) {
+    return false;
+  }
+
+  esp_err_t err = esp_partition_write(partition, raw_log_sector_offset() + position, record, current_record_size);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to write record to sector %d %s", next_sector, esp_err_to_name(err));
+    return false;
+  }
+  return true;
+}
+
+void raw_log_end() {
+  if (partition != NULL) {
+    raw_log_seal_sector();
+  }
+}
+
+// An unsealed sector was cut short by a reset, its records run up to the first one that is still erased
+static uint16_t raw_log_unsealed_length(const uint8_t *payload, uint16_t record_size) {
+  uint16_t length = 0;
+
+  while (length + record_size <= RAW_LOG_PAYLOAD_SIZE) {
+    bool is_erased = true;
+    for (uint16_t i = 0; i < record_size && is_erased; i++) {
+      is_erased = payload[length + i] == 0xFF;
+    }
+    if (is_erased) {
+      break;
+    }
+    length += record_size;
+  }
+
+  return length;
+}
+
+// Walks the ring from the oldest sector and hands out records of the session from sectors with a valid crc
+uint32_t raw_log_read_session(uint32_t session, raw_log_record_cb_t callback, void *context) {
+  uint32_t records = 0;
+
+  if (partition == NULL) {
+    return 0;
+  }
+
+  struct RawLogSectorHeader *header = (struct RawLogSectorHeader *)sector_buffer;
+  uint8_t *payload = sector_buffer + sizeof(struct RawLogSectorHeader);
+
+  for (uint32_t i = 0; i < sector_count; i++) {
+    uint32_t offset = ((next_sector + i) % sector_count) * RAW_LOG_SECTOR_SIZE;
+
+    if (esp_partition_read(partition, offset, header, sizeof(struct RawLogSectorHeader)) != ESP_OK) {
+      continue;
+    }
+    if (header->magic != RAW_LOG_MAGIC || header->session != session || header->record_size == 0 ||
+        header->record_size > RAW_LOG_PAYLOAD_SIZE) {
+      continue;
+    }
+    if (esp_partition_read(partition, offset + sizeof(struct RawLogSectorHeader), payload, RAW_LOG_PAYLOAD_SIZE) !=
+        ESP_OK) {
+      continue;
+    }
+
+    bool is_sealed = header->length <= RAW_LOG_PAYLOAD_SIZE && raw_log_crc(header, payload) == header->crc;
+    if (!is_sealed) {
+      // a reset while sealing leaves length or crc half programmed, the records themselves were already in flash
+      if (header->length != RAW_LOG_UNSEALED_LENGTH) {
+        ESP_LOGE(TAG, "Bad seal in sector %d", offset / RAW_LOG_SECTOR_SIZE);
+      }
+      header->length = raw_log_unsealed_length(payload, header->record_size);
+      ESP_LOGI(TAG, "Unsealed sector %d with %d bytes", offset / RAW_LOG_SECTOR_SIZE, header->length);
+    }
+
+    for (uint16_t position = 0; position + header->record_size <= header->length; position += header->record_size) {
+      callback(payload + position, context);
+      records++;
+    }
+  }
+
+  return records;
+}
@@ -0,0 +1,36 @@
+#ifndef raw_log_h
+#define raw_log_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RAW_LOG_PARTITION_LABEL "ridelog"
+#define RAW_LOG_SECTOR_SIZE 4096
+#define RAW_LOG_MAGIC 0x474F4C52
+
+// Length and crc still erased, the sector was being written when the device reset
+#define RAW_LOG_UNSEALED_LENGTH 0xFFFF
+
+// Written at the start of every sector, crc covers the header (with crc set to 0) and the used payload. Length and
+// crc are only programmed once the sector is sealed
+struct RawLogSectorHeader {
+  uint32_t magic;
+  uint32_t sequence;
+  uint32_t session;
+  uint16_t record_size;
+  uint16_t length;
+  uint32_t crc;
+} __attribute__((packed));
+
+typedef void (*raw_log_record_cb_t)(const void *record, void *context);
+
+bool raw_log_init();
+bool raw_log_is_available();
+
+void raw_log_begin(uint32_t session, uint16_t record_size);
+bool raw_log_append(const void *record);
+void raw_log_end();
+
+uint32_t raw_log_read_session(uint32_t session, raw_log_record_cb_t callback, void *context);
+
+#endif
@@ -0,0 +1,213 @@
+#include "retention.h"
+#include "esp_log.h"
+#include "ff.h"
+#include "log_shard.h"
+#include "logger.h"
+#include "storage_space.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+static const char *TAG = "retention";
+
+extern struct Settings settings;
+
+#define SECONDS_PER_DAY (24 * 60 * 60)
+
+struct RetentionCandidate {
+  time_t time;
+  uint32_t size;
+  char path[LOG_SHARD_PATH_MAX];
+};
+
+struct RetentionScan {
+  uint8_t count;
+  uint64_t bytes;
+  bool charge_logs_only;
+};
+
+static struct RetentionCandidate candidates[RETENTION_BATCH_SIZE];
+
+void retention_default_settings(struct RetentionSettings *retention) {
+  retention->max_age_days = RETENTION_DEFAULT_MAX_AGE_DAYS;
+  retention->max_synced_mb = RETENTION_DEFAULT_MAX_SYNCED_MB;
+  retention->min_free_mb = RETENTION_DEFAULT_MIN_FREE_MB;
+}
+
+// Log names carry their start time as <prefix>.<year>.<month>.<day>.<hour>.<minute>.<second>.log,
+// daily charge archives only the date
+static bool retention_parse_time(const char *name, struct tm *time) {
+  const char *start = strchr(name, '.');
+
+  memset(time, 0, sizeof(struct tm));
+  if (start == NULL || sscanf(start, ".%d.%d.%d.%d.%d.%d.log", &time->tm_year, &time->tm_mon, &time->tm_mday,
+                              &time->tm_hour, &time->tm_min, &time->tm_sec) < 3) {
+    return false;
+  }
+  time->tm_year -= 1900;
+  return true;
+}
+
+// Keeps the batch sorted by time and only the oldest entries once it is full
+static uint8_t retention_add_candidate(uint8_t count, time_t time, const char *dir, FILINFO *file) {
+  if (count == RETENTION_BATCH_SIZE && time >= candidates[count - 1].time) {
+    return count;
+  }
+
+  uint8_t position = count < RETENTION_BATCH_SIZE ? count : count - 1;
+  while (position > 0 && candidates[position - 1].time > time) {
+    candidates[position] = candidates[position - 1];
+    position--;
+  }
+
+  candidates[position].time = time;
+  candidates[position].size = file->fsize;
+  snprintf(candidates[position].path, sizeof(candidates[position].path), "%s/%s", dir, file->fname);
+
+  return count < RETENTION_BATCH_SIZE ? count + 1 : count;
+}
+
+static bool retention_delete(const char *path, uint32_t size) {
+  FRESULT res = f_unlink(path);
+  if (res != FR_OK) {
+    ESP_LOGE(TAG, "Failed to delete %s %d", path, res);
+    return false;
+  }
+
+  storage_space_allocate(-(int32_t)storage_space_clusters(size));
+  return true;
+}
+
+// Appends a tiny synced charge log to the archive for its day, the header is only kept once per archive
+static bool retention_archive(struct RetentionCandidate *candidate) {
+  struct tm time;
+  char path[LOG_FILENAME_MAX];
+  char archive_path[LOG_FILENAME_MAX];
+  char line[256];
+
+  const char *name = strrchr(candidate->path, '/') + 1;
+  if (!retention_parse_time(name, &time)) {
+    return false;
+  }
+
+  snprintf(path, sizeof(path), "%s%s", BASE_LOCATION, candidate->path);
+  snprintf(archive_path, sizeof(archive_path), "%s%.*s/charges.%d.%02d.%02d.log", BASE_LOCATION,
+           (int)(name - candidate->path - 1), candidate->path, time.tm_year + 1900, time.tm_mon, time.tm_mday);
+
+  FILE *source = fopen(path, "r");
+  if (source == NULL) {
+    return false;
+  }
+
+  struct stat archive_stat;
+  bool skip_header = stat(archive_path, &archive_stat) == 0 && archive_stat.st_size > 0;
+
+  FILE *archive = fopen(archive_path, "a");
+  if (archive == NULL) {
+    fclose(source);
+    return false;
+  }
+
+  while (fgets(line, sizeof(line), source) != NULL) {
+    if (skip_header) {
+      skip_header = line[strlen(line) - 1] != '\n';
+      continue;
+    }
+    fputs(line, archive);
+  }
+
+  fclose(archive);
+  fclose(source);
+
+  return retention_delete(candidate->path, candidate->size);
+}
+
+static bool retention_scan_file(const char *dir, FILINFO *file, void *context) {
+  struct RetentionScan *scan = context;
+  struct tm time;
+
+  scan->bytes += file->fsize;
+
+  if (scan->charge_logs_only &&
+      (strncmp(file->fname, "charge.", 7) != 0 || file->fsize >= RETENTION_TINY_LOG_SIZE)) {
+    return true;
+  }
+  if (retention_parse_time(file->fname, &time)) {
+    scan->count = retention_add_candidate(scan->count, mktime(&time), dir, file);
+  }
+  return true;
+}
+
+static void retention_merge_charge_logs() {
+  struct RetentionScan scan;
+  uint32_t merged = 0;
+
+  do {
+    memset(&scan, 0, sizeof(scan));
+    scan.charge_logs_only = true;
+    log_shard_walk(SYNCED_LOGS_LOCATION, retention_scan_file, &scan);
+
+    for (uint8_t i = 0; i < scan.count; i++) {
+      if (!retention_archive(&candidates[i])) {
+        scan.count = 0;
+        break;
+      }
+      merged++;
+    }
+  } while (scan.count == RETENTION_BATCH_SIZE && !state_is_in_driving_state());
+
+  if (merged > 0) {
+    ESP_LOGI(TAG, "Merged %d charge logs", merged);
+    storage_space_invalidate();
+  }
+}
+
+// Tracks and telemetry are never uploaded, so the synced log budgets don't apply to them. Each root only keeps
+// its own size cap, the oldest files beyond it are dropped no matter how old they are or how full the card is
+static const struct RetentionSettings tracks_budget = {.max_synced_mb = RETENTION_TRACKS_MAX_MB};
+static const struct RetentionSettings telemetry_budget = {.max_synced_mb = RETENTION_TELEMETRY_MAX_MB};
+
+static bool retention_should_delete(struct RetentionCandidate *candidate, const struct RetentionSettings *budget,
+                                    uint64_t bytes, time_t now) {
+  if (budget->max_age_days > 0 && candidate->time < now - (time_t)budget->max_age_days * SECONDS_PER_DAY) {
+    return true;
+  }
+  if (budget->max_synced_mb > 0 && bytes > (uint64_t)budget->max_synced_mb * 1024 * 1024) {
+    return true;
+  }
+  return budget->min_free_mb > 0 && storage_space_free_mb() < budget->min_free_mb;
+}
+
+// Deletes files under root oldest first until the age and size budgets hold, one bounded batch per directory pass
+static void retention_delete_old_files(const char *root, const struct RetentionSettings *budget) {
+  struct RetentionScan scan;
+  uint32_t deleted = 0;
+  time_t now = time(NULL);
+
+  do {
+    memset(&scan, 0, sizeof(scan));
+    log_shard_walk(root, retention_scan_file, &scan);
+
+    for (uint8_t i = 0; i < scan.count; i++) {
+      if (!retention_should_delete(&candidates[i], budget, scan.bytes, now) || state_is_in_driving_state() ||
+          !retention_delete(candidates[i].path, candidates[i].size)) {
+        scan.count = 0;
+        break;
+      }
+      scan.bytes -= candidates[i].size;
+      deleted++;
+    }
+  } while (scan.count == RETENTION_BATCH_SIZE);
+
+  if (deleted > 0) {
+    ESP_LOGI(TAG, "Deleted %d files from %s", deleted, root);
+  }
+}
+
+void retention_run() {
+  retention_merge_charge_logs();
+  retention_delete_old_files(SYNCED_LOGS_LOCATION, &settings.retention);
+  retention_delete_old_files(TRACKS_LOCATION, &tracks_budget);
+  retention_delete_old_files(TELEMETRY_LOCATION, &telemetry_budget);
+}
@@ -0,0 +1,20 @@
+#ifndef retention_h
+#define retention_h
+
+#include "state.h"
+
+#define RETENTION_DEFAULT_MAX_AGE_DAYS 365
+#define RETENTION_DEFAULT_MAX_SYNCED_MB 0
+#define RETENTION_DEFAULT_MIN_FREE_MB 256
+// Size caps for the local only roots, these are never uploaded and never held to the synced log budgets
+#define RETENTION_TRACKS_MAX_MB 64
+#define RETENTION_TELEMETRY_MAX_MB 1024
+
+#define RETENTION_INTERVAL_MS (60 * 60 * 1000)
+#define RETENTION_TINY_LOG_SIZE (8 * 1024)
+#define RETENTION_BATCH_SIZE 16
+
+void retention_default_settings(struct RetentionSettings *retention);
+void retention_run();
+
+#endif
@@ -0,0 +1,219 @@
+#include "ride_index.h"
+#include "esp_log.h"
+#include "ff.h"
+#include "log_shard.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+static const char *TAG = "ride_index";
+
+#define RIDE_INDEX_PATH BASE_LOCATION RIDE_INDEX_LOCATION
+
+#define RIDE_INDEX_SYNCED_BIT 0x80000000
+
+struct RideIndexCollector {
+  uint32_t *entries;
+  uint32_t count;
+  uint32_t max;
+  bool is_synced;
+};
+
+static bool ride_index_count_file(const char *dir, FILINFO *file, void *context) {
+  (*(uint32_t *)context)++;
+  return true;
+}
+
+static uint32_t ride_index_count_files(const char *path) {
+  uint32_t count = 0;
+  log_shard_walk(path, ride_index_count_file, &count);
+  return count;
+}
+
+// Collects ride start times encoded in log file names, top bit marks logs that were already synced
+static bool ride_index_collect_file(const char *dir, FILINFO *file, void *context) {
+  struct RideIndexCollector *collector = context;
+  struct tm time;
+
+  memset(&time, 0, sizeof(time));
+  if (sscanf(file->fname, "log.%d.%d.%d.%d.%d.%d.log", &time.tm_year, &time.tm_mon, &time.tm_mday, &time.tm_hour,
+             &time.tm_min, &time.tm_sec) == 6) {
+    time.tm_year -= 1900;
+    collector->entries[collector->count++] =
+        (uint32_t)mktime(&time) | (collector->is_synced ? RIDE_INDEX_SYNCED_BIT : 0);
+  }
+  return collector->count < collector->max;
+}
+
+static uint32_t ride_index_collect(const char *path, uint32_t *entries, uint32_t count, uint32_t max, bool is_synced) {
+  struct RideIndexCollector collector = {.entries = entries, .count = count, .max = max, .is_synced = is_synced};
+
+  if (count < max) {
+    log_shard_walk(path, ride_index_collect_file, &collector);
+  }
+  return collector.count;
+}
+
+static int ride_index_compare(const void *a, const void *b) {
+  uint32_t left = *(const uint32_t *)a & ~RIDE_INDEX_SYNCED_BIT;
+  uint32_t right = *(const uint32_t *)b & ~RIDE_INDEX_SYNCED_BIT;
+  return left < right ? -1 : left > right;
+}
+
+static void ride_index_rebuild() {
+  uint32_t max = ride_index_count_files(LOGS_LOCATION) + ride_index_count_files(SYNCED_LOGS_LOCATION);
+  uint32_t *entries = malloc(max * sizeof(uint32_t) + 1);
+  if (entries == NULL) {
+    ESP_LOGE(TAG, "Failed to allocate %d entries", max);
+    return;
+  }
+
+  uint32_t count = ride_index_collect(LOGS_LOCATION, entries, 0, max, false);
+  count = ride_index_collect(SYNCED_LOGS_LOCATION, entries, count, max, true);
+  qsort(entries, count, sizeof(uint32_t), ride_index_compare);
+
+  FILE *f = fopen(RIDE_INDEX_PATH, "w");
+  if (f == NULL) {
+    ESP_LOGE(TAG, "Failed to open file for writing %s", RIDE_INDEX_PATH);
+    free(entries);
+    return;
+  }
+
+  struct RideIndexRecord record;
+  for (uint32_t i = 0; i < count; i++) {
+    memset(&record, 0, sizeof(record));
+    record.start_time = entries[i] & ~RIDE_INDEX_SYNCED_BIT;
+    record.flags = (entries[i] & RIDE_INDEX_SYNCED_BIT) ? RIDE_INDEX_FLAG_SYNCED : 0;
+    log_format_filename(record.filename, sizeof(record.filename), record.start_time);
+    fwrite(&record, sizeof(record), 1, f);
+  }
+  fclose(f);
+  free(entries);
+
+  ESP_LOGI(TAG, "Rebuilt index with %d rides", count);
+}
+
+void ride_index_init() {
+  struct stat file_stat;
+
+  if (stat(RIDE_INDEX_PATH, &file_stat) == -1) {
+    ride_index_rebuild();
+  }
+}
+
+void ride_index_append(struct RideIndexRecord *record) {
+  FILE *f = fopen(RIDE_INDEX_PATH, "a");
+  if (f == NULL) {
+    ESP_LOGE(TAG, "Failed to open file for writing %s", RIDE_INDEX_PATH);
+    return;
+  }
+
+  fwrite(record, sizeof(struct RideIndexRecord), 1, f);
+  fclose(f);
+}
+
+uint32_t ride_index_count() {
+  struct stat file_stat;
+
+  if (stat(RIDE_INDEX_PATH, &file_stat) == -1) {
+    return 0;
+  }
+
+  return file_stat.st_size / sizeof(struct RideIndexRecord);
+}
+
+static bool ride_index_read_from(FILE *f, uint32_t position, struct RideIndexRecord *record) {
+  return fseek(f, position * sizeof(struct RideIndexRecord), SEEK_SET) == 0 &&
+         fread(record, sizeof(struct RideIndexRecord), 1, f) == 1;
+}
+
+// Binary search by start time, the index is appended in ride order
+static uint32_t ride_index_find(FILE *f, uint32_t count, uint32_t time) {
+  uint32_t low = 0;
+  uint32_t high = count;
+  struct RideIndexRecord record;
+
+  while (low < high) {
+    uint32_t middle = low + (high - low) / 2;
+    if (!ride_index_read_from(f, middle, &record)) {
+      break;
+    }
+
+    if (record.start_time < time) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+// Only the search seeks, the records from there on are read sequentially through the stdio buffer. A missing
+// index leaves an empty cursor, next then returns false right away
+bool ride_index_open(struct RideIndexCursor *cursor, uint32_t time) {
+  struct stat file_stat;
+
+  cursor->count = 0;
+  cursor->position = 0;
+  cursor->file = fopen(RIDE_INDEX_PATH, "r");
+  if (cursor->file == NULL) {
+    return false;
+  }
+
+  if (fstat(fileno(cursor->file), &file_stat) == 0) {
+    cursor->count = file_stat.st_size / sizeof(struct RideIndexRecord);
+  }
+  cursor->position = ride_index_find(cursor->file, cursor->count, time);
+
+  if (fseek(cursor->file, cursor->position * sizeof(struct RideIndexRecord), SEEK_SET) != 0) {
+    cursor->position = cursor->count;
+  }
+  return true;
+}
+
+bool ride_index_next(struct RideIndexCursor *cursor, struct RideIndexRecord *record) {
+  if (cursor->file == NULL || cursor->position >= cursor->count ||
+      fread(record, sizeof(struct RideIndexRecord), 1, cursor->file) != 1) {
+    return false;
+  }
+
+  cursor->position++;
+  return true;
+}
+
+void ride_index_close(struct RideIndexCursor *cursor) {
+  if (cursor->file != NULL) {
+    fclose(cursor->file);
+    cursor->file = NULL;
+  }
+}
+
+void ride_index_mark_synced(const char *filename) {
+  struct RideIndexRecord record;
+  uint32_t position = ride_index_count();
+
+  FILE *f = fopen(RIDE_INDEX_PATH, "r+");
+  if (f == NULL) {
+    return;
+  }
+
+  // not yet synced rides are at the end of the index
+  while (position > 0) {
+    position--;
+    if (!ride_index_read_from(f, position, &record)) {
+      break;
+    }
+
+    if (strncmp(record.filename, filename, sizeof(record.filename)) == 0) {
+      record.flags |= RIDE_INDEX_FLAG_SYNCED;
+      fseek(f, position * sizeof(struct RideIndexRecord), SEEK_SET);
+      fwrite(&record, sizeof(record), 1, f);
+      break;
+    }
+  }
+  fclose(f);
+}
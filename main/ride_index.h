@@ -0,0 +1,43 @@
+#ifndef ride_index_h
+#define ride_index_h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define RIDE_INDEX_LOCATION "/rides.idx"
+#define RIDE_INDEX_FILENAME_MAX 32
+
+#define RIDE_INDEX_FLAG_SYNCED 0x01
+
+struct RideIndexRecord {
+  uint32_t start_time;
+  uint32_t duration;
+  float distance;
+  float energy;
+  uint8_t flags;
+  char filename[RIDE_INDEX_FILENAME_MAX];
+} __attribute__((packed));
+
+struct RideIndexEntry {
+  uint32_t count;
+  uint32_t position;
+  struct RideIndexRecord record;
+} __attribute__((packed));
+
+// Walks the index through a single open file, starting at the first ride at or after the time passed to open
+struct RideIndexCursor {
+  FILE *file;
+  uint32_t count;
+  uint32_t position;
+};
+
+void ride_index_init();
+void ride_index_append(struct RideIndexRecord *record);
+uint32_t ride_index_count();
+bool ride_index_open(struct RideIndexCursor *cursor, uint32_t time);
+bool ride_index_next(struct RideIndexCursor *cursor, struct RideIndexRecord *record);
+void ride_index_close(struct RideIndexCursor *cursor);
+void ride_index_mark_synced(const char *filename);
+
+#endif
@@ -0,0 +1,117 @@
+#include "ride_summary.h"
+#include "esp_log.h"
+#include "logger.h"
+#include "sd_writer.h"
+#include "service_state.h"
+#include "state.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static const char *TAG = "summary";
+
+// altitude changes below this are GPS noise rather than climbing
+#define ELEVATION_THRESHOLD_M 3.0f
+
+struct RideSummary ride_summary;
+// Copy the writer task appends, the next ride's summary can start before it gets to it
+static struct RideSummary saved_summary;
+static time_t last_sample_time;
+static float reference_altitude;
+static bool has_altitude = false;
+
+void ride_summary_start(time_t start_time) {
+  memset(&ride_summary, 0, sizeof(ride_summary));
+  ride_summary.start_time = start_time;
+  last_sample_time = start_time;
+  has_altitude = false;
+}
+
+void ride_summary_add_sample(time_t timestamp) {
+  struct CurrentState *state = state_get();
+  uint32_t dt = timestamp - last_sample_time;
+  last_sample_time = timestamp;
+
+  float current = state->current.value;
+  float speed = state->speed.value;
+
+  ride_summary.energy += state->voltage.value * current * dt / 3600.0f;
+
+  if (speed > ride_summary.max_speed) {
+    ride_summary.max_speed = speed;
+  }
+  if (current > ride_summary.max_current) {
+    ride_summary.max_current = current;
+  }
+
+  if (state->gps_fix_status > 0) {
+    float altitude = state->altitude.value;
+    if (!has_altitude) {
+      reference_altitude = altitude;
+      has_altitude = true;
+    } else if (altitude > reference_altitude + ELEVATION_THRESHOLD_M) {
+      ride_summary.elevation_gain += altitude - reference_altitude;
+      reference_altitude = altitude;
+    } else if (altitude < reference_altitude - ELEVATION_THRESHOLD_M) {
+      reference_altitude = altitude;
+    }
+  }
+}
+
+// Runs on the writer task. The next ride waits in sd_writer_close for everything queued before its track is closed,
+// so saved_summary is written before that ride finishes and replaces it
+static void ride_summary_save(void *context) {
+  const char *name = BASE_LOCATION RIDE_SUMMARY_LOCATION;
+  struct stat file_stat;
+  bool is_new = stat(name, &file_stat) == -1;
+
+  FILE *f = fopen(name, "a");
+  if (f == NULL) {
+    ESP_LOGE(TAG, "Failed to open file for writing %s", name);
+    return;
+  }
+
+  if (is_new) {
+    fprintf(f, "start_time,duration,distance,max_speed,average_speed,energy,energy_per_km,elevation_gain,max_current,"
+               "track_points,track_kept_points,track_max_deviation\n");
+  }
+
+  fprintf(f, "%d,%d,%.3f,%.1f,%.1f,%.2f,%.2f,%.1f,%.2f,%d,%d,%.2f\n", saved_summary.start_time, saved_summary.duration,
+          saved_summary.distance, saved_summary.max_speed, saved_summary.average_speed, saved_summary.energy,
+          saved_summary.energy_per_km, saved_summary.elevation_gain, saved_summary.max_current,
+          saved_summary.track_points, saved_summary.track_kept_points, saved_summary.track_max_deviation);
+
+  fclose(f);
+}
+
+void ride_summary_finish(struct TrackSummary *track) {
+  struct CurrentState *state = state_get();
+
+  ride_summary.duration = last_sample_time - ride_summary.start_time;
+  ride_summary.distance = state->trip_distance.value;
+
+  if (ride_summary.duration > 0) {
+    ride_summary.average_speed = ride_summary.distance * 3600 / ride_summary.duration;
+  }
+  if (ride_summary.distance > 0) {
+    ride_summary.energy_per_km = ride_summary.energy / ride_summary.distance;
+  }
+
+  if (track != NULL) {
+    ride_summary.track_points = track->points;
+    ride_summary.track_kept_points = track->kept_points;
+    ride_summary.track_max_deviation = track->max_deviation;
+  }
+
+  ESP_LOGI(TAG, "ride %d s %.2f km %.1f Wh max %.1f km/h", ride_summary.duration, ride_summary.distance,
+           ride_summary.energy, ride_summary.max_speed);
+
+  saved_summary = ride_summary;
+  sd_writer_call(ride_summary_save, NULL);
+  state_ride_summary_update();
+}
+
+struct RideSummary *ride_summary_get() {
+  return &ride_summary;
+}
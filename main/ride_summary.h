@@ -0,0 +1,30 @@
+#ifndef ride_summary_h
+#define ride_summary_h
+
+#include "track.h"
+#include <stdint.h>
+#include <time.h>
+
+#define RIDE_SUMMARY_LOCATION "/summaries.csv"
+
+struct RideSummary {
+  uint32_t start_time;
+  uint32_t duration;
+  float distance;
+  float max_speed;
+  float average_speed;
+  float energy;
+  float energy_per_km;
+  float elevation_gain;
+  float max_current;
+  uint32_t track_points;
+  uint32_t track_kept_points;
+  float track_max_deviation;
+} __attribute__((packed));
+
+void ride_summary_start(time_t start_time);
+void ride_summary_add_sample(time_t timestamp);
+void ride_summary_finish(struct TrackSummary *track);
+struct RideSummary *ride_summary_get();
+
+#endif
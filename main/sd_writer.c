@@ -0,0 +1,197 @@
+#include "sd_writer.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "sd_writer";
+
+// write jobs are bounded by the buffers, the rest leaves room for opens, closes and calls of a few streams
+#define SD_WRITER_QUEUE_SIZE (SD_WRITER_BUFFER_COUNT + 8)
+
+typedef enum {
+  SD_WRITER_JOB_OPEN,
+  SD_WRITER_JOB_REOPEN,
+  SD_WRITER_JOB_WRITE,
+  SD_WRITER_JOB_CLOSE,
+  SD_WRITER_JOB_CALL
+} sd_writer_job_t;
+
+struct SdWriterJob {
+  sd_writer_job_t type;
+  struct SdWriterStream *stream;
+  uint8_t *buffer;
+  size_t length;
+  uint32_t preallocate_size;
+  SemaphoreHandle_t done;
+  sd_writer_call_t callback;
+  void *context;
+};
+
+static QueueHandle_t jobs = NULL;
+static QueueHandle_t free_buffers = NULL;
+
+// Only this task touches the card once a stream is open, so a slow write never stalls the producers
+static void sd_writer_task(void *params) {
+  struct SdWriterJob job;
+
+  while (1) {
+    xQueueReceive(jobs, &job, portMAX_DELAY);
+
+    switch (job.type) {
+    case SD_WRITER_JOB_OPEN:
+      // f_open and the contiguous preallocation can take hundreds of ms on a fragmented card
+      log_file_open(&job.stream->file, job.stream->name, job.preallocate_size);
+      break;
+    case SD_WRITER_JOB_REOPEN:
+      if (log_file_reopen(&job.stream->file, job.stream->name)) {
+        __atomic_store_n(&job.stream->written, (uint32_t)f_tell(&job.stream->file.file), __ATOMIC_RELEASE);
+      } else {
+        __atomic_store_n(&job.stream->is_failed, true, __ATOMIC_RELEASE);
+      }
+      break;
+    case SD_WRITER_JOB_WRITE:
+      if (job.length > 0 && job.stream->file.is_open &&
+          log_file_write(&job.stream->file, (const char *)job.buffer, job.length)) {
+        __atomic_store_n(&job.stream->written, (uint32_t)f_tell(&job.stream->file.file), __ATOMIC_RELEASE);
+      } else if (job.length > 0) {
+        // other streams and the file server may have files open, so the card is never remounted from here
+        if (job.stream->file.is_open) {
+          ESP_LOGE(TAG, "Write failed, closing %s", job.stream->name);
+          log_file_close(&job.stream->file);
+          __atomic_store_n(&job.stream->is_failed, true, __ATOMIC_RELEASE);
+        }
+        __atomic_add_fetch(&job.stream->dropped, job.length, __ATOMIC_RELAXED);
+      }
+      xQueueSend(free_buffers, &job.buffer, portMAX_DELAY);
+      break;
+    case SD_WRITER_JOB_CLOSE:
+      log_file_close(&job.stream->file);
+      xSemaphoreGive(job.done);
+      break;
+    case SD_WRITER_JOB_CALL:
+      job.callback(job.context);
+      break;
+    }
+  }
+}
+
+void sd_writer_init() {
+  jobs = xQueueCreate(SD_WRITER_QUEUE_SIZE, sizeof(struct SdWriterJob));
+  free_buffers = xQueueCreate(SD_WRITER_BUFFER_COUNT, sizeof(uint8_t *));
+
+  for (uint8_t i = 0; i < SD_WRITER_BUFFER_COUNT; i++) {
+    uint8_t *buffer = heap_caps_malloc(SD_WRITER_BUFFER_SIZE, MALLOC_CAP_DMA);
+    if (buffer == NULL) {
+      ESP_LOGE(TAG, "Failed to allocate buffer %d", i);
+      continue;
+    }
+    xQueueSend(free_buffers, &buffer, 0);
+  }
+
+  // below the sampling tasks, which all run at the top priority on the other core
+  xTaskCreatePinnedToCore(sd_writer_task, "sd_writer_task", 1024 * 4, NULL, configMAX_PRIORITIES - 2, NULL,
+                          SD_WRITER_CORE);
+}
+
+// Runs callback on the writer task after everything queued before it, for card I/O that isn't a stream
+void sd_writer_call(sd_writer_call_t callback, void *context) {
+  struct SdWriterJob job = {.type = SD_WRITER_JOB_CALL, .callback = callback, .context = context};
+  xQueueSend(jobs, &job, portMAX_DELAY);
+}
+
+// Only queues the open, the writer task creates and preallocates the file ahead of the first write. Returns false
+// if the name doesn't fit, a failure to open is logged by the writer task
+bool sd_writer_open(struct SdWriterStream *stream, const char *name, uint32_t preallocate_size) {
+  stream->buffer = NULL;
+  stream->length = 0;
+  stream->dropped = 0;
+  stream->written = 0;
+  stream->flushed_at = esp_timer_get_time();
+  stream->is_failed = false;
+  memset(&stream->file, 0, sizeof(stream->file));
+
+  if (strlcpy(stream->name, name, sizeof(stream->name)) >= sizeof(stream->name)) {
+    ESP_LOGE(TAG, "Name too long %s", name);
+    return false;
+  }
+
+  struct SdWriterJob job = {.type = SD_WRITER_JOB_OPEN, .stream = stream, .preallocate_size = preallocate_size};
+  xQueueSend(jobs, &job, portMAX_DELAY);
+  return true;
+}
+
+// Called by the owner from its loop, a stream closed after a failed write is reopened for appending on the writer
+// task. Returns true when a reopen was queued, if that fails too the stream is marked failed again
+bool sd_writer_reopen_if_failed(struct SdWriterStream *stream) {
+  if (!__atomic_exchange_n(&stream->is_failed, false, __ATOMIC_ACQ_REL)) {
+    return false;
+  }
+
+  struct SdWriterJob job = {.type = SD_WRITER_JOB_REOPEN, .stream = stream};
+  xQueueSend(jobs, &job, portMAX_DELAY);
+  return true;
+}
+
+// Never waits for a buffer, data that doesn't fit while all buffers are in flight is counted as dropped
+bool sd_writer_append(struct SdWriterStream *stream, const void *data, size_t length) {
+  if (stream->buffer != NULL && stream->length + length > SD_WRITER_BUFFER_SIZE) {
+    sd_writer_flush(stream);
+  }
+
+  if (stream->buffer == NULL && xQueueReceive(free_buffers, &stream->buffer, 0) != pdTRUE) {
+    stream->buffer = NULL;
+    __atomic_add_fetch(&stream->dropped, length, __ATOMIC_RELAXED);
+    return false;
+  }
+
+  if (length > SD_WRITER_BUFFER_SIZE - stream->length) {
+    __atomic_add_fetch(&stream->dropped, length, __ATOMIC_RELAXED);
+    return false;
+  }
+
+  memcpy(stream->buffer + stream->length, data, length);
+  stream->length += length;
+  return true;
+}
+
+// Hands the filled buffer to the writer task, the next append takes a fresh one
+void sd_writer_flush(struct SdWriterStream *stream) {
+  if (stream->buffer == NULL) {
+    return;
+  }
+
+  struct SdWriterJob job = {
+      .type = SD_WRITER_JOB_WRITE, .stream = stream, .buffer = stream->buffer, .length = stream->length};
+  xQueueSend(jobs, &job, portMAX_DELAY);
+
+  stream->buffer = NULL;
+  stream->length = 0;
+  stream->flushed_at = esp_timer_get_time();
+}
+
+// Batches small records into one card write, a reset loses at most SD_WRITER_FLUSH_INTERVAL_MS of data
+void sd_writer_flush_if_due(struct SdWriterStream *stream) {
+  if (stream->length >= SD_WRITER_FLUSH_SIZE ||
+      esp_timer_get_time() - stream->flushed_at >= SD_WRITER_FLUSH_INTERVAL_MS * 1000LL) {
+    sd_writer_flush(stream);
+  }
+}
+
+// Waits until everything queued for the stream is written and the file is truncated and closed
+void sd_writer_close(struct SdWriterStream *stream) {
+  sd_writer_flush(stream);
+
+  struct SdWriterJob job = {.type = SD_WRITER_JOB_CLOSE, .stream = stream, .done = xSemaphoreCreateBinary()};
+  xQueueSend(jobs, &job, portMAX_DELAY);
+  xSemaphoreTake(job.done, portMAX_DELAY);
+  vSemaphoreDelete(job.done);
+
+  if (stream->dropped > 0) {
+    ESP_LOGE(TAG, "Dropped %d bytes", stream->dropped);
+  }
+}
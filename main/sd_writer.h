@@ -0,0 +1,42 @@
+#ifndef sd_writer_h
+#define sd_writer_h
+
+#include "log_file.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SD_WRITER_BUFFER_SIZE 4096
+#define SD_WRITER_BUFFER_COUNT 4
+#define SD_WRITER_CORE 0
+#define SD_WRITER_NAME_MAX 80
+// A partly filled buffer is handed over once it holds this much or has waited this long
+#define SD_WRITER_FLUSH_SIZE (SD_WRITER_BUFFER_SIZE / 2)
+#define SD_WRITER_FLUSH_INTERVAL_MS 5000
+
+// Producer side of one file, the producer fills buffer while the previous one is written by the writer task. A
+// failed write closes the file and sets is_failed, data queued after that is dropped until the owner reopens it
+struct SdWriterStream {
+  struct LogFile file;
+  char name[SD_WRITER_NAME_MAX];
+  uint8_t *buffer;
+  size_t length;
+  uint32_t dropped;
+  uint32_t written;
+  int64_t flushed_at;
+  bool is_failed;
+};
+
+typedef void (*sd_writer_call_t)(void *context);
+
+void sd_writer_init();
+void sd_writer_call(sd_writer_call_t callback, void *context);
+
+bool sd_writer_open(struct SdWriterStream *stream, const char *name, uint32_t preallocate_size);
+bool sd_writer_reopen_if_failed(struct SdWriterStream *stream);
+bool sd_writer_append(struct SdWriterStream *stream, const void *data, size_t length);
+void sd_writer_flush(struct SdWriterStream *stream);
+void sd_writer_flush_if_due(struct SdWriterStream *stream);
+void sd_writer_close(struct SdWriterStream *stream);
+
+#endif
@@ -90,6 +90,8 @@ static const uint16_t GATTS_CHAR_UUID_VOLTAGE = 0xFF01;
 static const uint16_t GATTS_CHAR_UUID_CURRENT = 0xFF02;
 static const uint16_t GATTS_CHAR_UUID_USED_ENERGY = 0xFF03;
 static const uint16_t GATTS_CHAR_UUID_TOTAL_ENERGY = 0xFF04;
+static const uint16_t GATTS_CHAR_UUID_SOC = 0xFF05;
+static const uint16_t GATTS_CHAR_UUID_RANGE = 0xFF06;
 
 static const uint16_t primary_service_uuid = ESP_GATT_UUID_PRI_SERVICE;
 static const uint16_t character_declaration_uuid = ESP_GATT_UUID_CHAR_DECLARE;
@@ -165,6 +167,36 @@ static const esp_gatts_attr_db_t gatt_db[BATTERY_IDX_NB] = {
                                     ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(uint16_t),
                                     sizeof(config_descriptor), (uint8_t *)config_descriptor}},
 
+    /* Characteristic Declaration */
+    [IDX_CHAR_SOC] = {{ESP_GATT_AUTO_RSP},
+                      {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                       CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE, (uint8_t *)&char_prop_read}},
+    /* Characteristic Value */
+    [IDX_CHAR_VAL_SOC] = {{ESP_GATT_AUTO_RSP},
+                          {ESP_UUID_LEN_16, (uint8_t *)&GATTS_CHAR_UUID_SOC, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+                           GATTS_DEMO_CHAR_VAL_LEN_MAX, sizeof(state.state_of_charge.bytes),
+                           (uint8_t *)state.state_of_charge.bytes}},
+    /* Client Characteristic Configuration Descriptor */
+    [IDX_CHAR_CFG_SOC] = {{ESP_GATT_AUTO_RSP},
+                          {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid,
+                           ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(uint16_t), sizeof(config_descriptor),
+                           (uint8_t *)config_descriptor}},
+
+    /* Characteristic Declaration */
+    [IDX_CHAR_RANGE] = {{ESP_GATT_AUTO_RSP},
+                        {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                         CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE, (uint8_t *)&char_prop_read}},
+    /* Characteristic Value */
+    [IDX_CHAR_VAL_RANGE] = {{ESP_GATT_AUTO_RSP},
+                            {ESP_UUID_LEN_16, (uint8_t *)&GATTS_CHAR_UUID_RANGE,
+                             ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, GATTS_DEMO_CHAR_VAL_LEN_MAX,
+                             sizeof(state.range.bytes), (uint8_t *)state.range.bytes}},
+    /* Client Characteristic Configuration Descriptor */
+    [IDX_CHAR_CFG_RANGE] = {{ESP_GATT_AUTO_RSP},
+                            {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid,
+                             ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(uint16_t), sizeof(config_descriptor),
+                             (uint8_t *)config_descriptor}},
+
 };
 
 struct gatts_profile_inst init_battery_service() {
@@ -228,6 +260,10 @@ void gatts_service_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts
         battery_update_value(state.used_energy.value, IDX_CHAR_VAL_USED_ENERGY, true);
       } else if (index == IDX_CHAR_CFG_TOTAL_ENERGY) {
         battery_update_value(state.total_energy.value, IDX_CHAR_VAL_TOTAL_ENERGY, true);
+      } else if (index == IDX_CHAR_CFG_SOC) {
+        battery_update_value(state.state_of_charge.value, IDX_CHAR_VAL_SOC, true);
+      } else if (index == IDX_CHAR_CFG_RANGE) {
+        battery_update_value(state.range.value, IDX_CHAR_VAL_RANGE, true);
       }
     }
     break;
@@ -311,6 +347,18 @@ void battery_update_value(double value, uint16_t characteristic_index, bool forc
       was_changed = true;
     }
     break;
+  case IDX_CHAR_VAL_SOC:
+    if (state.state_of_charge.value != value) {
+      state.state_of_charge.value = value;
+      was_changed = true;
+    }
+    break;
+  case IDX_CHAR_VAL_RANGE:
+    if (state.range.value != value) {
+      state.range.value = value;
+      was_changed = true;
+    }
+    break;
   default:
     break;
   }
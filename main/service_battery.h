@@ -29,6 +29,14 @@ enum {
   IDX_CHAR_VAL_TOTAL_ENERGY,
   IDX_CHAR_CFG_TOTAL_ENERGY,
 
+  IDX_CHAR_SOC,
+  IDX_CHAR_VAL_SOC,
+  IDX_CHAR_CFG_SOC,
+
+  IDX_CHAR_RANGE,
+  IDX_CHAR_VAL_RANGE,
+  IDX_CHAR_CFG_RANGE,
+
   BATTERY_IDX_NB,
 };
 
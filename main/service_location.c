@@ -91,6 +91,7 @@ static const uint16_t GATTS_CHAR_UUID_TRIP_DISTANCE = 0xFE04;
 
 static const uint16_t GATTS_CHAR_UUID_GPS_FIX_STATUS = 0xFE05;
 static const uint16_t GATTS_CHAR_UUID_GPG_SATELITE_COUNT = 0xFE06;
+static const uint16_t GATTS_CHAR_UUID_HEADING = 0xFE07;
 
 static const uint16_t primary_service_uuid = ESP_GATT_UUID_PRI_SERVICE;
 static const uint16_t character_declaration_uuid = ESP_GATT_UUID_CHAR_DECLARE;
@@ -191,6 +192,20 @@ static const esp_gatts_attr_db_t gatt_db[LOCATION_IDX_NB] = {
                                          {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid,
                                           ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(uint16_t),
                                           sizeof(config_descriptor), (uint8_t *)config_descriptor}},
+
+    [IDX_CHAR_HEADING] = {{ESP_GATT_AUTO_RSP},
+                          {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                           CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE, (uint8_t *)&char_prop_read}},
+    /* Characteristic Value */
+    [IDX_CHAR_VAL_HEADING] = {{ESP_GATT_AUTO_RSP},
+                              {ESP_UUID_LEN_16, (uint8_t *)&GATTS_CHAR_UUID_HEADING,
+                               ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, GATTS_DEMO_CHAR_VAL_LEN_MAX,
+                               sizeof(state.heading.bytes), (uint8_t *)state.heading.bytes}},
+    /* Client Characteristic Configuration Descriptor */
+    [IDX_CHAR_CFG_HEADING] = {{ESP_GATT_AUTO_RSP},
+                              {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid,
+                               ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(uint16_t), sizeof(config_descriptor),
+                               (uint8_t *)config_descriptor}},
 };
 
 struct gatts_profile_inst init_location_service() {
@@ -251,6 +266,8 @@ void location_service_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t ga
         location_update_u8_value(state.gps_fix_status, IDX_CHAR_VAL_GPS_FIX, true);
       } else if (index == IDX_CHAR_CFG_GPS_SATELITE_COUNT) {
         location_update_u8_value(state.gps_satelites_count, IDX_CHAR_VAL_GPS_SATELITE_COUNT, true);
+      } else if (index == IDX_CHAR_CFG_HEADING) {
+        location_update_value(state.heading.value, IDX_CHAR_VAL_HEADING, true);
       }
     }
     break;
@@ -354,6 +371,12 @@ void location_update_value(double value, uint16_t characteristic_index, bool for
       was_changed = true;
     }
     break;
+  case IDX_CHAR_VAL_HEADING:
+    if (state.heading.value != value) {
+      state.heading.value = value;
+      was_changed = true;
+    }
+    break;
   default:
     break;
   }
@@ -36,6 +36,10 @@ enum {
   IDX_CHAR_VAL_GPS_SATELITE_COUNT,
   IDX_CHAR_CFG_GPS_SATELITE_COUNT,
 
+  IDX_CHAR_HEADING,
+  IDX_CHAR_VAL_HEADING,
+  IDX_CHAR_CFG_HEADING,
+
   LOCATION_IDX_NB,
 };
 
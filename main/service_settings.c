@@ -10,6 +10,7 @@
 #include "esp_gap_ble_api.h"
 #include "esp_gatt_common_api.h"
 #include "esp_gatts_api.h"
+#include "battery_soc.h"
 #include "gatt.h"
 #include "power.h"
 #include "service_settings.h"
@@ -36,6 +37,9 @@ static uint8_t adv_config_done = 0;
 
 uint16_t settings_handle_table[SETTINGS_IDX_NB];
 
+// Readable copy of settings.wifi_profiles, passwords stay write only
+static struct WifiProfile published_profiles[WIFI_PROFILE_COUNT];
+
 uint16_t settings_notification_table[SETTINGS_IDX_NB];
 
 static uint16_t connection_id;
@@ -103,6 +107,14 @@ static const uint16_t GATTS_CHAR_UUID_DEVICE_KEY = 0xFD09;
 static const uint16_t GATTS_CHAR_UUID_WIFI_SSID_CLIENT = 0xFD0A;
 static const uint16_t GATTS_CHAR_UUID_WIFI_PASS_CLIENT = 0xFD0B;
 static const uint16_t GATTS_CHAR_UUID_UPLOAD_INTERVAL = 0xFD0C;
+static const uint16_t GATTS_CHAR_UUID_BATTERY_CELLS = 0xFD0D;
+static const uint16_t GATTS_CHAR_UUID_BATTERY_CAPACITY = 0xFD0E;
+static const uint16_t GATTS_CHAR_UUID_ACTIVITY = 0xFD0F;
+static const uint16_t GATTS_CHAR_UUID_LOG_BACKEND = 0xFD10;
+static const uint16_t GATTS_CHAR_UUID_TELEMETRY_RATE = 0xFD11;
+static const uint16_t GATTS_CHAR_UUID_RETENTION = 0xFD12;
+static const uint16_t GATTS_CHAR_UUID_STATIC_IP = 0xFD13;
+static const uint16_t GATTS_CHAR_UUID_WIFI_PROFILES = 0xFD14;
 
 static const uint16_t primary_service_uuid = ESP_GATT_UUID_PRI_SERVICE;
 static const uint16_t character_declaration_uuid = ESP_GATT_UUID_CHAR_DECLARE;
@@ -255,9 +267,102 @@ static const esp_gatts_attr_db_t gatt_db[SETTINGS_IDX_NB] = {
                                                    sizeof(settings.upload_interval), sizeof(settings.upload_interval),
                                                    (uint8_t *)&settings.upload_interval}},
 
+    /* Characteristic Declaration */
+    [IDX_CHAR_BATTERY_CELLS] = {{ESP_GATT_AUTO_RSP},
+                                {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                                 CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE, (uint8_t *)&char_prop_read_write}},
+    /* Characteristic Value */
+    [IDX_CHAR_VAL_BATTERY_CELLS] = {{ESP_GATT_AUTO_RSP},
+                                    {ESP_UUID_LEN_16, (uint8_t *)&GATTS_CHAR_UUID_BATTERY_CELLS,
+                                     ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(settings.battery_cells),
+                                     sizeof(settings.battery_cells), (uint8_t *)&settings.battery_cells}},
+
+    /* Characteristic Declaration */
+    [IDX_CHAR_BATTERY_CAPACITY] = {{ESP_GATT_AUTO_RSP},
+                                   {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                                    CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE, (uint8_t *)&char_prop_read_write}},
+    /* Characteristic Value */
+    [IDX_CHAR_VAL_BATTERY_CAPACITY] = {{ESP_GATT_AUTO_RSP},
+                                       {ESP_UUID_LEN_16, (uint8_t *)&GATTS_CHAR_UUID_BATTERY_CAPACITY,
+                                        ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(settings.battery_capacity),
+                                        sizeof(settings.battery_capacity), (uint8_t *)&settings.battery_capacity}},
+
+    /* Characteristic Declaration */
+    [IDX_CHAR_ACTIVITY] = {{ESP_GATT_AUTO_RSP},
+                           {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                            CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE, (uint8_t *)&char_prop_read_write}},
+    /* Characteristic Value */
+    [IDX_CHAR_VAL_ACTIVITY] = {{ESP_GATT_AUTO_RSP},
+                               {ESP_UUID_LEN_16, (uint8_t *)&GATTS_CHAR_UUID_ACTIVITY,
+                                ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(settings.activity),
+                                sizeof(settings.activity), (uint8_t *)&settings.activity}},
+
+    /* Characteristic Declaration */
+    [IDX_CHAR_LOG_BACKEND] = {{ESP_GATT_AUTO_RSP},
+                              {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                               CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE, (uint8_t *)&char_prop_read_write}},
+    /* Characteristic Value */
+    [IDX_CHAR_VAL_LOG_BACKEND] = {{ESP_GATT_AUTO_RSP},
+                                  {ESP_UUID_LEN_16, (uint8_t *)&GATTS_CHAR_UUID_LOG_BACKEND,
+                                   ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(settings.log_backend),
+                                   sizeof(settings.log_backend), (uint8_t *)&settings.log_backend}},
+
+    /* Characteristic Declaration */
+    [IDX_CHAR_TELEMETRY_RATE] = {{ESP_GATT_AUTO_RSP},
+                                 {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                                  CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE, (uint8_t *)&char_prop_read_write}},
+    /* Characteristic Value */
+    [IDX_CHAR_VAL_TELEMETRY_RATE] = {{ESP_GATT_AUTO_RSP},
+                                     {ESP_UUID_LEN_16, (uint8_t *)&GATTS_CHAR_UUID_TELEMETRY_RATE,
+                                      ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(settings.telemetry_rate),
+                                      sizeof(settings.telemetry_rate), (uint8_t *)&settings.telemetry_rate}},
+
+    /* Characteristic Declaration */
+    [IDX_CHAR_RETENTION] = {{ESP_GATT_AUTO_RSP},
+                            {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                             CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE, (uint8_t *)&char_prop_read_write}},
+    /* Characteristic Value */
+    [IDX_CHAR_VAL_RETENTION] = {{ESP_GATT_AUTO_RSP},
+                                {ESP_UUID_LEN_16, (uint8_t *)&GATTS_CHAR_UUID_RETENTION,
+                                 ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(settings.retention),
+                                 sizeof(settings.retention), (uint8_t *)&settings.retention}},
+
+    /* Characteristic Declaration */
+    [IDX_CHAR_STATIC_IP] = {{ESP_GATT_AUTO_RSP},
+                            {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                             CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE, (uint8_t *)&char_prop_read_write}},
+    /* Characteristic Value */
+    [IDX_CHAR_VAL_STATIC_IP] = {{ESP_GATT_AUTO_RSP},
+                                {ESP_UUID_LEN_16, (uint8_t *)&GATTS_CHAR_UUID_STATIC_IP,
+                                 ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(settings.static_ip),
+                                 sizeof(settings.static_ip), (uint8_t *)&settings.static_ip}},
+
+    /* Characteristic Declaration */
+    [IDX_CHAR_WIFI_PROFILES] = {{ESP_GATT_AUTO_RSP},
+                                {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                                 CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE, (uint8_t *)&char_prop_read_write}},
+    /* Characteristic Value */
+    [IDX_CHAR_VAL_WIFI_PROFILES] = {{ESP_GATT_AUTO_RSP},
+                                    {ESP_UUID_LEN_16, (uint8_t *)&GATTS_CHAR_UUID_WIFI_PROFILES,
+                                     ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(settings.wifi_profiles),
+                                     sizeof(published_profiles), (uint8_t *)published_profiles}},
+
 };
 
+// Refreshes the readable profile table, called after every change to settings.wifi_profiles
+void settings_publish_wifi_profiles() {
+  memcpy(published_profiles, settings.wifi_profiles, sizeof(published_profiles));
+  for (uint8_t i = 0; i < WIFI_PROFILE_COUNT; i++) {
+    memset(published_profiles[i].pass, 0, sizeof(published_profiles[i].pass));
+  }
+
+  if (settings_handle_table[IDX_CHAR_VAL_WIFI_PROFILES] != 0) {
+    settings_set_value(IDX_CHAR_VAL_WIFI_PROFILES, sizeof(published_profiles), (uint8_t *)published_profiles);
+  }
+}
+
 struct gatts_profile_inst init_settings_service() {
+  settings_publish_wifi_profiles();
   return settings_profile_tab;
 }
 
@@ -318,13 +423,17 @@ void settings_set_state(uint16_t handle, uint8_t *value, uint16_t len) {
   } else if (handle == settings_handle_table[IDX_CHAR_VAL_WIFI_SSID_CLIENT]) {
     memcpy(settings.wifi_ssid_client, value, len);
     settings.wifi_ssid_client[len] = 0;
+    memcpy(settings.wifi_profiles[0].ssid, settings.wifi_ssid_client, sizeof(settings.wifi_profiles[0].ssid));
     settings_save();
+    settings_publish_wifi_profiles();
     ESP_LOGI(GATTS_TABLE_TAG, "settings_set_state IDX_CHAR_VAL_WIFI_SSID_CLIENT %s", settings.wifi_ssid_client);
 
   } else if (handle == settings_handle_table[IDX_CHAR_VAL_WIFI_PASS_CLIENT]) {
     memcpy(settings.wifi_pass_client, value, len);
     settings.wifi_pass_client[len] = 0;
+    memcpy(settings.wifi_profiles[0].pass, settings.wifi_pass_client, sizeof(settings.wifi_profiles[0].pass));
     settings_save();
+    settings_publish_wifi_profiles();
     ESP_LOGI(GATTS_TABLE_TAG, "settings_set_state IDX_CHAR_VAL_WIFI_PASS_CLIENT %s", settings.wifi_pass_client);
 
   } else if (handle == settings_handle_table[IDX_CHAR_VAL_DEVICE_KEY]) {
@@ -338,6 +447,86 @@ void settings_set_state(uint16_t handle, uint8_t *value, uint16_t len) {
     settings_save();
     ESP_LOGI(GATTS_TABLE_TAG, "settings_set_state IDX_CHAR_VAL_UPLOAD_INTERVAL %d", settings.upload_interval);
 
+  } else if (handle == settings_handle_table[IDX_CHAR_VAL_BATTERY_CELLS]) {
+    if (len != sizeof(settings.battery_cells))
+      return;
+
+    settings.battery_cells = value[0];
+    settings_save();
+    soc_init(settings.battery_cells, settings.battery_capacity);
+    ESP_LOGI(GATTS_TABLE_TAG, "settings_set_state IDX_CHAR_VAL_BATTERY_CELLS %d", settings.battery_cells);
+
+  } else if (handle == settings_handle_table[IDX_CHAR_VAL_BATTERY_CAPACITY]) {
+    if (len != sizeof(settings.battery_capacity))
+      return;
+
+    memcpy(&settings.battery_capacity, value, len);
+    settings_save();
+    soc_init(settings.battery_cells, settings.battery_capacity);
+    ESP_LOGI(GATTS_TABLE_TAG, "settings_set_state IDX_CHAR_VAL_BATTERY_CAPACITY %d", settings.battery_capacity);
+
+  } else if (handle == settings_handle_table[IDX_CHAR_VAL_ACTIVITY]) {
+    if (len != sizeof(settings.activity))
+      return;
+
+    memcpy(&settings.activity, value, len);
+    settings_save();
+    ESP_LOGI(GATTS_TABLE_TAG, "settings_set_state IDX_CHAR_VAL_ACTIVITY %d %d", settings.activity.riding_current_level,
+             settings.activity.idle_time);
+
+  } else if (handle == settings_handle_table[IDX_CHAR_VAL_LOG_BACKEND]) {
+    if (len != sizeof(settings.log_backend) || value[0] >= LOG_BACKEND_COUNT)
+      return;
+
+    settings.log_backend = value[0];
+    settings_save();
+    ESP_LOGI(GATTS_TABLE_TAG, "settings_set_state IDX_CHAR_VAL_LOG_BACKEND %d", settings.log_backend);
+
+  } else if (handle == settings_handle_table[IDX_CHAR_VAL_TELEMETRY_RATE]) {
+    if (len != sizeof(settings.telemetry_rate))
+      return;
+
+    settings.telemetry_rate = value[0];
+    settings_save();
+    ESP_LOGI(GATTS_TABLE_TAG, "settings_set_state IDX_CHAR_VAL_TELEMETRY_RATE %d", settings.telemetry_rate);
+
+  } else if (handle == settings_handle_table[IDX_CHAR_VAL_RETENTION]) {
+    if (len != sizeof(settings.retention))
+      return;
+
+    memcpy(&settings.retention, value, len);
+    settings_save();
+    ESP_LOGI(GATTS_TABLE_TAG, "settings_set_state IDX_CHAR_VAL_RETENTION %d %d %d", settings.retention.max_age_days,
+             settings.retention.max_synced_mb, settings.retention.min_free_mb);
+
+  } else if (handle == settings_handle_table[IDX_CHAR_VAL_STATIC_IP]) {
+    if (len != sizeof(settings.static_ip))
+      return;
+
+    memcpy(&settings.static_ip, value, len);
+    settings_save();
+    ESP_LOGI(GATTS_TABLE_TAG, "settings_set_state IDX_CHAR_VAL_STATIC_IP %08x", settings.static_ip.ip);
+
+  } else if (handle == settings_handle_table[IDX_CHAR_VAL_WIFI_PROFILES]) {
+    // one profile per write: index followed by struct WifiProfile, an empty ssid clears the slot
+    if (len != 1 + sizeof(struct WifiProfile) || value[0] >= WIFI_PROFILE_COUNT)
+      return;
+
+    struct WifiProfile *profile = &settings.wifi_profiles[value[0]];
+    memcpy(profile, value + 1, sizeof(struct WifiProfile));
+    profile->ssid[sizeof(profile->ssid) - 1] = 0;
+    profile->pass[sizeof(profile->pass) - 1] = 0;
+    profile->last_rssi = INT8_MIN;
+
+    if (value[0] == 0) {
+      memcpy(settings.wifi_ssid_client, profile->ssid, sizeof(settings.wifi_ssid_client));
+      memcpy(settings.wifi_pass_client, profile->pass, sizeof(settings.wifi_pass_client));
+    }
+    settings_save();
+    settings_publish_wifi_profiles();
+    ESP_LOGI(GATTS_TABLE_TAG, "settings_set_state IDX_CHAR_VAL_WIFI_PROFILES %d %s priority %d", value[0],
+             profile->ssid, profile->priority);
+
   } else if (handle == settings_handle_table[IDX_CHAR_VAL_TIME]) {
     if (len != 6)
       return;
@@ -434,6 +623,7 @@ void settings_service_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t ga
                param->add_attr_tab.num_handle);
       memcpy(settings_handle_table, param->add_attr_tab.handles, sizeof(settings_handle_table));
       esp_ble_gatts_start_service(settings_handle_table[IDX_SVC_SETTINGS]);
+      settings_publish_wifi_profiles();
     }
     break;
   }
@@ -52,6 +52,30 @@ enum {
   IDX_CHAR_WIFI_CLIENT_UPLOAD_INTERVAL,
   IDX_CHAR_VAL_WIFI_CLIENT_UPLOAD_INTERVAL,
 
+  IDX_CHAR_BATTERY_CELLS,
+  IDX_CHAR_VAL_BATTERY_CELLS,
+
+  IDX_CHAR_BATTERY_CAPACITY,
+  IDX_CHAR_VAL_BATTERY_CAPACITY,
+
+  IDX_CHAR_ACTIVITY,
+  IDX_CHAR_VAL_ACTIVITY,
+
+  IDX_CHAR_LOG_BACKEND,
+  IDX_CHAR_VAL_LOG_BACKEND,
+
+  IDX_CHAR_TELEMETRY_RATE,
+  IDX_CHAR_VAL_TELEMETRY_RATE,
+
+  IDX_CHAR_RETENTION,
+  IDX_CHAR_VAL_RETENTION,
+
+  IDX_CHAR_STATIC_IP,
+  IDX_CHAR_VAL_STATIC_IP,
+
+  IDX_CHAR_WIFI_PROFILES,
+  IDX_CHAR_VAL_WIFI_PROFILES,
+
   SETTINGS_IDX_NB,
 };
 
@@ -60,5 +84,6 @@ void settings_service_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t ga
                                     esp_ble_gatts_cb_param_t *param);
 void settings_update_value(void *value, uint16_t characteristic_index);
 void settings_set_value(uint16_t handle_idx, uint16_t len, const uint8_t *value);
+void settings_publish_wifi_profiles();
 
 #endif
\ No newline at end of file
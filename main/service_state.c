@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "esp_bt.h"
 #include "esp_log.h"
 #include "esp_system.h"
@@ -11,8 +13,11 @@
 #include "esp_gatt_common_api.h"
 #include "esp_gatts_api.h"
 #include "gatt.h"
+#include "ride_index.h"
+#include "ride_summary.h"
 #include "service_state.h"
 #include "state.h"
+#include "telemetry.h"
 
 #define GATTS_TABLE_TAG "StateService"
 
@@ -43,6 +48,10 @@ uint8_t state_service_uuid[16] = {
 };
 
 extern struct CurrentStateAdvertisment adv_state;
+extern struct RideSummary ride_summary;
+extern struct TelemetryStats telemetry_stats;
+
+struct RideIndexEntry ride_index_entry;
 
 /* The length of adv data must be less than 31 bytes */
 esp_ble_adv_data_t state_adv_data = {
@@ -89,10 +98,15 @@ struct gatts_profile_inst state_profile_tab = {
 };
 static const uint16_t GATTS_SERVICE_UUID = 0x00FF;
 static const uint16_t GATTS_CHAR_UUID_STATE = 0xFFFF;
+static const uint16_t GATTS_CHAR_UUID_RIDE_SUMMARY = 0xFFFE;
+static const uint16_t GATTS_CHAR_UUID_RIDE_INDEX = 0xFFFD;
+static const uint16_t GATTS_CHAR_UUID_TELEMETRY_STATS = 0xFFFC;
 
 static const uint16_t primary_service_uuid = ESP_GATT_UUID_PRI_SERVICE;
 static const uint16_t character_declaration_uuid = ESP_GATT_UUID_CHAR_DECLARE;
 static const uint8_t char_prop_read = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+static const uint8_t char_prop_read_write_notify =
+    ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_NOTIFY | ESP_GATT_CHAR_PROP_BIT_WRITE;
 
 static const uint16_t character_client_config_uuid = ESP_GATT_UUID_CHAR_CLIENT_CONFIG;
 static const uint8_t config_descriptor[2] = {0x00, 0x00};
@@ -119,6 +133,50 @@ static const esp_gatts_attr_db_t gatt_db[STATE_IDX_NB] = {
                              ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(uint16_t), sizeof(config_descriptor),
                              (uint8_t *)config_descriptor}},
 
+    /* Characteristic Declaration */
+    [IDX_CHAR_RIDE_SUMMARY] = {{ESP_GATT_AUTO_RSP},
+                               {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                                CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE, (uint8_t *)&char_prop_read}},
+    /* Characteristic Value */
+    [IDX_CHAR_VAL_RIDE_SUMMARY] = {{ESP_GATT_AUTO_RSP},
+                                   {ESP_UUID_LEN_16, (uint8_t *)&GATTS_CHAR_UUID_RIDE_SUMMARY, ESP_GATT_PERM_READ,
+                                    sizeof(ride_summary), sizeof(ride_summary), (uint8_t *)&ride_summary}},
+    /* Client Characteristic Configuration Descriptor */
+    [IDX_CHAR_CFG_RIDE_SUMMARY] = {{ESP_GATT_AUTO_RSP},
+                                   {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid,
+                                    ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(uint16_t),
+                                    sizeof(config_descriptor), (uint8_t *)config_descriptor}},
+
+    /* Characteristic Declaration */
+    [IDX_CHAR_RIDE_INDEX] = {{ESP_GATT_AUTO_RSP},
+                             {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                              CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE, (uint8_t *)&char_prop_read_write_notify}},
+    /* Characteristic Value */
+    [IDX_CHAR_VAL_RIDE_INDEX] = {{ESP_GATT_AUTO_RSP},
+                                 {ESP_UUID_LEN_16, (uint8_t *)&GATTS_CHAR_UUID_RIDE_INDEX,
+                                  ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(ride_index_entry),
+                                  sizeof(ride_index_entry), (uint8_t *)&ride_index_entry}},
+    /* Client Characteristic Configuration Descriptor */
+    [IDX_CHAR_CFG_RIDE_INDEX] = {{ESP_GATT_AUTO_RSP},
+                                 {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid,
+                                  ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(uint16_t),
+                                  sizeof(config_descriptor), (uint8_t *)config_descriptor}},
+
+    /* Characteristic Declaration */
+    [IDX_CHAR_TELEMETRY_STATS] = {{ESP_GATT_AUTO_RSP},
+                                  {ESP_UUID_LEN_16, (uint8_t *)&character_declaration_uuid, ESP_GATT_PERM_READ,
+                                   CHAR_DECLARATION_SIZE, CHAR_DECLARATION_SIZE, (uint8_t *)&char_prop_read}},
+    /* Characteristic Value */
+    [IDX_CHAR_VAL_TELEMETRY_STATS] = {{ESP_GATT_AUTO_RSP},
+                                      {ESP_UUID_LEN_16, (uint8_t *)&GATTS_CHAR_UUID_TELEMETRY_STATS,
+                                       ESP_GATT_PERM_READ, sizeof(telemetry_stats), sizeof(telemetry_stats),
+                                       (uint8_t *)&telemetry_stats}},
+    /* Client Characteristic Configuration Descriptor */
+    [IDX_CHAR_CFG_TELEMETRY_STATS] = {{ESP_GATT_AUTO_RSP},
+                                      {ESP_UUID_LEN_16, (uint8_t *)&character_client_config_uuid,
+                                       ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(uint16_t),
+                                       sizeof(config_descriptor), (uint8_t *)config_descriptor}},
+
 };
 
 struct gatts_profile_inst init_state_service() {
@@ -170,7 +228,13 @@ void state_gatts_service_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t
              param->write.len);
     esp_log_buffer_hex(GATTS_TABLE_TAG, state_handle_table, 20);
 
-    if (!param->write.is_prep) {
+    if (param->write.handle == state_handle_table[IDX_CHAR_VAL_RIDE_INDEX]) {
+      if (param->write.len == sizeof(uint32_t)) {
+        uint32_t time;
+        memcpy(&time, param->write.value, sizeof(time));
+        state_ride_index_update(time);
+      }
+    } else if (!param->write.is_prep) {
       uint16_t descr_value = param->write.value[1] << 8 | param->write.value[0];
 
       uint16_t index = 0;
@@ -187,6 +251,8 @@ void state_gatts_service_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t
 
       if (index == IDX_CHAR_CFG_STATE) {
         state_update();
+      } else if (index == IDX_CHAR_CFG_RIDE_SUMMARY) {
+        state_ride_summary_update();
       }
     }
     break;
@@ -249,6 +315,48 @@ void state_update() {
   }
 }
 
+void state_ride_summary_update() {
+  esp_ble_gatts_set_attr_value(state_handle_table[IDX_CHAR_VAL_RIDE_SUMMARY], sizeof(ride_summary),
+                               (uint8_t *)&ride_summary);
+
+  if (state_notification_table[IDX_CHAR_CFG_RIDE_SUMMARY] == 0x0001) {
+    esp_ble_gatts_send_indicate(state_profile_tab.gatts_if, connection_id,
+                                state_handle_table[IDX_CHAR_VAL_RIDE_SUMMARY], sizeof(ride_summary),
+                                (uint8_t *)&ride_summary, false);
+  }
+}
+
+// Selects the first ride that started at or after given time, the app iterates by writing start_time + 1
+void state_ride_index_update(uint32_t time) {
+  struct RideIndexCursor cursor;
+
+  memset(&ride_index_entry, 0, sizeof(ride_index_entry));
+  ride_index_open(&cursor, time);
+  ride_index_entry.count = cursor.count;
+  ride_index_entry.position = cursor.position;
+  ride_index_next(&cursor, &ride_index_entry.record);
+  ride_index_close(&cursor);
+
+  esp_ble_gatts_set_attr_value(state_handle_table[IDX_CHAR_VAL_RIDE_INDEX], sizeof(ride_index_entry),
+                               (uint8_t *)&ride_index_entry);
+
+  if (state_notification_table[IDX_CHAR_CFG_RIDE_INDEX] == 0x0001) {
+    esp_ble_gatts_send_indicate(state_profile_tab.gatts_if, connection_id, state_handle_table[IDX_CHAR_VAL_RIDE_INDEX],
+                                sizeof(ride_index_entry), (uint8_t *)&ride_index_entry, false);
+  }
+}
+
+void state_telemetry_stats_update() {
+  esp_ble_gatts_set_attr_value(state_handle_table[IDX_CHAR_VAL_TELEMETRY_STATS], sizeof(telemetry_stats),
+                               (uint8_t *)&telemetry_stats);
+
+  if (state_notification_table[IDX_CHAR_CFG_TELEMETRY_STATS] == 0x0001) {
+    esp_ble_gatts_send_indicate(state_profile_tab.gatts_if, connection_id,
+                                state_handle_table[IDX_CHAR_VAL_TELEMETRY_STATS], sizeof(telemetry_stats),
+                                (uint8_t *)&telemetry_stats, false);
+  }
+}
+
 bool is_state_service_connected() {
   return is_state_connected;
 }
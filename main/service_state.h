@@ -18,6 +18,18 @@ enum {
   IDX_CHAR_VAL_STATE,
   IDX_CHAR_CFG_STATE,
 
+  IDX_CHAR_RIDE_SUMMARY,
+  IDX_CHAR_VAL_RIDE_SUMMARY,
+  IDX_CHAR_CFG_RIDE_SUMMARY,
+
+  IDX_CHAR_RIDE_INDEX,
+  IDX_CHAR_VAL_RIDE_INDEX,
+  IDX_CHAR_CFG_RIDE_INDEX,
+
+  IDX_CHAR_TELEMETRY_STATS,
+  IDX_CHAR_VAL_TELEMETRY_STATS,
+  IDX_CHAR_CFG_TELEMETRY_STATS,
+
   STATE_IDX_NB,
 };
 
@@ -25,6 +37,9 @@ struct gatts_profile_inst init_state_service();
 void state_gatts_service_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
                                        esp_ble_gatts_cb_param_t *param);
 void state_update();
+void state_ride_summary_update();
+void state_ride_index_update(uint32_t time);
+void state_telemetry_stats_update();
 
 bool is_state_service_connected();
 
@@ -1,7 +1,10 @@
 #include "esp_log.h"
 #include "esp_system.h"
+#include "activity_detector.h"
 #include "nvs_flash.h"
+#include "retention.h"
 #include "state.h"
+#include <string.h>
 
 extern struct CurrentState state;
 extern struct Settings settings;
@@ -17,6 +20,20 @@ const char *TAG = "Settings";
 
 #define KEY_WIFI_CLIENT_UPLOAD_INTERVAL "wifi_client_upload_interval"
 
+#define KEY_BATTERY_CELLS "battery_cells"
+#define KEY_BATTERY_CAPACITY "battery_cap"
+
+#define KEY_ACTIVITY "activity"
+
+#define KEY_LOG_BACKEND "log_backend"
+#define KEY_TELEMETRY_RATE "telemetry_rate"
+
+#define KEY_RETENTION "retention"
+
+#define KEY_STATIC_IP "static_ip"
+
+#define KEY_WIFI_PROFILES "wifi_profiles"
+
 void settings_load() {
   esp_err_t err;
   nvs_handle_t my_handle;
@@ -43,6 +60,33 @@ void settings_load() {
 
     nvs_get_u16(my_handle, KEY_WIFI_CLIENT_UPLOAD_INTERVAL, &settings.upload_interval);
 
+    nvs_get_u8(my_handle, KEY_BATTERY_CELLS, &settings.battery_cells);
+    nvs_get_u16(my_handle, KEY_BATTERY_CAPACITY, &settings.battery_capacity);
+
+    len = sizeof(settings.activity);
+    if (nvs_get_blob(my_handle, KEY_ACTIVITY, &settings.activity, &len) != ESP_OK) {
+      activity_default_settings(&settings.activity);
+    }
+
+    nvs_get_u8(my_handle, KEY_LOG_BACKEND, &settings.log_backend);
+    nvs_get_u8(my_handle, KEY_TELEMETRY_RATE, &settings.telemetry_rate);
+
+    len = sizeof(settings.retention);
+    if (nvs_get_blob(my_handle, KEY_RETENTION, &settings.retention, &len) != ESP_OK) {
+      retention_default_settings(&settings.retention);
+    }
+
+    len = sizeof(settings.static_ip);
+    nvs_get_blob(my_handle, KEY_STATIC_IP, &settings.static_ip, &len);
+
+    len = sizeof(settings.wifi_profiles);
+    if (nvs_get_blob(my_handle, KEY_WIFI_PROFILES, settings.wifi_profiles, &len) != ESP_OK) {
+      memset(settings.wifi_profiles, 0, sizeof(settings.wifi_profiles));
+      memcpy(settings.wifi_profiles[0].ssid, settings.wifi_ssid_client, sizeof(settings.wifi_profiles[0].ssid));
+      memcpy(settings.wifi_profiles[0].pass, settings.wifi_pass_client, sizeof(settings.wifi_profiles[0].pass));
+      settings.wifi_profiles[0].last_rssi = INT8_MIN;
+    }
+
     nvs_close(my_handle);
   }
 }
@@ -64,6 +108,20 @@ void settings_save() {
 
     nvs_set_u16(my_handle, KEY_WIFI_CLIENT_UPLOAD_INTERVAL, (char *)settings.upload_interval);
 
+    nvs_set_u8(my_handle, KEY_BATTERY_CELLS, settings.battery_cells);
+    nvs_set_u16(my_handle, KEY_BATTERY_CAPACITY, settings.battery_capacity);
+
+    nvs_set_blob(my_handle, KEY_ACTIVITY, &settings.activity, sizeof(settings.activity));
+
+    nvs_set_u8(my_handle, KEY_LOG_BACKEND, settings.log_backend);
+    nvs_set_u8(my_handle, KEY_TELEMETRY_RATE, settings.telemetry_rate);
+
+    nvs_set_blob(my_handle, KEY_RETENTION, &settings.retention, sizeof(settings.retention));
+
+    nvs_set_blob(my_handle, KEY_STATIC_IP, &settings.static_ip, sizeof(settings.static_ip));
+
+    nvs_set_blob(my_handle, KEY_WIFI_PROFILES, settings.wifi_profiles, sizeof(settings.wifi_profiles));
+
     err = nvs_commit(my_handle);
     if (err != ESP_OK) {
       ESP_LOGE(TAG, "Failed to save settings");
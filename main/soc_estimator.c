@@ -0,0 +1,82 @@
+#include "soc_estimator.h"
+
+#define SOC_OCV_POINTS 11
+#define SOC_OCV_STEP_PERMILLE 100
+#define SOC_REST_CURRENT_MA 150
+#define SOC_REST_TIME_US (30 * 1000 * 1000)
+#define SOC_OCV_BLEND_SHIFT 4
+
+// Resting cell voltage in mV for 0%, 10%, ... 100% state of charge of a typical Li-ion cell
+static const int16_t ocv_table[SOC_OCV_POINTS] = {3300, 3600, 3690, 3740, 3770, 3800, 3850, 3920, 3980, 4060, 4200};
+
+void soc_estimator_init(struct SocEstimator *estimator, uint8_t cells, uint16_t capacity_mah) {
+  estimator->cells = cells;
+  estimator->capacity_mas = capacity_mah * SOC_MAS_PER_MAH;
+  estimator->charge_mas = 0;
+  estimator->is_initialized = false;
+  estimator->last_update_time = 0;
+  estimator->rest_start_time = 0;
+}
+
+int64_t soc_estimator_ocv_to_charge(const struct SocEstimator *estimator, int32_t voltage_mv) {
+  int32_t cell_mv = voltage_mv / estimator->cells;
+
+  if (cell_mv <= ocv_table[0]) {
+    return 0;
+  }
+  if (cell_mv >= ocv_table[SOC_OCV_POINTS - 1]) {
+    return estimator->capacity_mas;
+  }
+
+  uint8_t i = 1;
+  while (cell_mv > ocv_table[i]) {
+    i++;
+  }
+
+  int32_t permille = (i - 1) * SOC_OCV_STEP_PERMILLE +
+                     (cell_mv - ocv_table[i - 1]) * SOC_OCV_STEP_PERMILLE / (ocv_table[i] - ocv_table[i - 1]);
+
+  return estimator->capacity_mas * permille / 1000;
+}
+
+void soc_estimator_update(struct SocEstimator *estimator, int32_t voltage_mv, int32_t current_ma, int64_t time_us) {
+  if (!estimator->is_initialized) {
+    if (voltage_mv <= 0) {
+      return;
+    }
+    estimator->charge_mas = soc_estimator_ocv_to_charge(estimator, voltage_mv);
+    estimator->last_update_time = time_us;
+    estimator->rest_start_time = time_us;
+    estimator->is_initialized = true;
+    return;
+  }
+
+  int64_t dt_ms = (time_us - estimator->last_update_time) / 1000;
+  estimator->last_update_time = time_us;
+
+  estimator->charge_mas -= (int64_t)current_ma * dt_ms;
+
+  if (current_ma < SOC_REST_CURRENT_MA && current_ma > -SOC_REST_CURRENT_MA) {
+    if (time_us - estimator->rest_start_time > SOC_REST_TIME_US) {
+      // voltage has relaxed, pull coulomb counter towards open circuit voltage estimate
+      int64_t ocv_charge = soc_estimator_ocv_to_charge(estimator, voltage_mv);
+      estimator->charge_mas += (ocv_charge - estimator->charge_mas) >> SOC_OCV_BLEND_SHIFT;
+    }
+  } else {
+    estimator->rest_start_time = time_us;
+  }
+
+  if (estimator->charge_mas < 0) {
+    estimator->charge_mas = 0;
+  } else if (estimator->charge_mas > estimator->capacity_mas) {
+    estimator->charge_mas = estimator->capacity_mas;
+  }
+}
+
+uint16_t soc_estimator_get_permille(const struct SocEstimator *estimator) {
+  return estimator->charge_mas * 1000 / estimator->capacity_mas;
+}
+
+uint32_t soc_estimator_get_remaining_mah(const struct SocEstimator *estimator) {
+  return estimator->charge_mas / SOC_MAS_PER_MAH;
+}
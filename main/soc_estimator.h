@@ -0,0 +1,27 @@
+#ifndef soc_estimator_h
+#define soc_estimator_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SOC_MAS_PER_MAH 3600000LL
+
+// Coulomb counter corrected towards the open circuit voltage while the pack rests. Pure state, no locking or timers,
+// so it can run on recorded ride logs on the host
+struct SocEstimator {
+  uint8_t cells;
+  int64_t capacity_mas;
+  int64_t charge_mas;
+  bool is_initialized;
+  int64_t last_update_time;
+  int64_t rest_start_time;
+};
+
+void soc_estimator_init(struct SocEstimator *estimator, uint8_t cells, uint16_t capacity_mah);
+void soc_estimator_update(struct SocEstimator *estimator, int32_t voltage_mv, int32_t current_ma, int64_t time_us);
+int64_t soc_estimator_ocv_to_charge(const struct SocEstimator *estimator, int32_t voltage_mv);
+
+uint16_t soc_estimator_get_permille(const struct SocEstimator *estimator);
+uint32_t soc_estimator_get_remaining_mah(const struct SocEstimator *estimator);
+
+#endif
@@ -22,6 +22,8 @@ typedef enum { WIFI_DISABLED, WIFI_AP, WIFI_CLIENT, WIFI_CLIENT_CONNECTED } wifi
 
 typedef enum { MANUAL_START_DISABLED, MANUAL_START_ENABLED } manual_start_t;
 
+typedef enum { LOG_BACKEND_FAT, LOG_BACKEND_RAW, LOG_BACKEND_BINARY, LOG_BACKEND_COUNT } log_backend_t;
+
 struct CurrentState {
   DoubleCharacteristic current;
   DoubleCharacteristic voltage;
@@ -45,8 +47,47 @@ struct CurrentState {
 
   uint32_t free_storage;
   uint32_t total_storage;
+
+  DoubleCharacteristic state_of_charge;
+  DoubleCharacteristic range;
+
+  DoubleCharacteristic heading;
 };
 
+struct ActivitySettings {
+  uint16_t riding_current_level;
+  uint16_t charging_current_level;
+  uint16_t hysteresis;
+  uint16_t start_time;
+  uint16_t idle_time;
+  uint16_t riding_speed_level;
+} __attribute__((packed));
+
+struct RetentionSettings {
+  uint16_t max_age_days;
+  uint16_t max_synced_mb;
+  uint16_t min_free_mb;
+} __attribute__((packed));
+
+// Addresses in network byte order, ip 0 keeps DHCP
+struct WifiStaticIp {
+  uint32_t ip;
+  uint32_t netmask;
+  uint32_t gateway;
+  uint32_t dns;
+} __attribute__((packed));
+
+#define WIFI_PROFILE_COUNT 4
+
+// Known client network, the one in range with the highest priority is used. Profile 0 mirrors
+// wifi_ssid_client/wifi_pass_client
+struct WifiProfile {
+  uint8_t ssid[21];
+  uint8_t pass[21];
+  uint8_t priority;
+  int8_t last_rssi;
+} __attribute__((packed));
+
 struct Settings {
   uint8_t manual_ride_start;
   wifi_state_t wifi_state;
@@ -57,6 +98,20 @@ struct Settings {
   uint8_t wifi_ssid_client[21];
   uint8_t wifi_pass_client[21];
   uint16_t upload_interval;
+
+  uint8_t battery_cells;
+  uint16_t battery_capacity;
+
+  struct ActivitySettings activity;
+
+  uint8_t log_backend;
+  uint8_t telemetry_rate;
+
+  struct RetentionSettings retention;
+
+  struct WifiStaticIp static_ip;
+
+  struct WifiProfile wifi_profiles[WIFI_PROFILE_COUNT];
 };
 
 struct CurrentState *state_get();
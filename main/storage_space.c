@@ -0,0 +1,88 @@
+#include "storage_space.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_vfs_fat.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "retention.h"
+#include "state.h"
+#include "uploader.h"
+
+static const char *TAG = "storage";
+
+static uint32_t cluster_bytes = 0;
+static uint32_t total_clusters = 0;
+static int32_t free_clusters = 0;
+
+static bool is_dirty = false;
+static int64_t last_reconcile_time = 0;
+static int64_t last_retention_time = 0;
+
+// Full free cluster count, on FAT32 without a valid FSINFO this walks the whole FAT
+static bool storage_space_reconcile() {
+  FATFS *fs;
+  DWORD fre_clust;
+
+  FRESULT res = f_getfree("/sdcard/", &fre_clust, &fs);
+  if (res) {
+    return false;
+  }
+
+  cluster_bytes = fs->csize * FF_SS_SDCARD;
+  total_clusters = fs->n_fatent - 2;
+  __atomic_store_n(&free_clusters, fre_clust, __ATOMIC_RELEASE);
+
+  is_dirty = false;
+  last_reconcile_time = esp_timer_get_time();
+
+  ESP_LOGI(TAG, "Reconciled free space %d/%d MB", storage_space_free_mb(), storage_space_total_mb());
+  return true;
+}
+
+// Runs only while parked so the scan and the retention pass never compete with a ride starting
+static void storage_space_task(void *params) {
+  while (1) {
+    vTaskDelay(STORAGE_RECONCILE_INTERVAL_MS / portTICK_PERIOD_MS);
+
+    if (state_is_in_driving_state() || state_is_in_charging_state()) {
+      continue;
+    }
+
+    if (!uploader_is_task_running() &&
+        (last_retention_time == 0 || (esp_timer_get_time() - last_retention_time) / 1000 > RETENTION_INTERVAL_MS)) {
+      last_retention_time = esp_timer_get_time();
+      retention_run();
+    }
+
+    int64_t age_ms = (esp_timer_get_time() - last_reconcile_time) / 1000;
+    if (is_dirty || cluster_bytes == 0 || age_ms > STORAGE_RECONCILE_MAX_AGE_MS) {
+      storage_space_reconcile();
+    }
+  }
+}
+
+void storage_space_init() {
+  storage_space_reconcile();
+
+  xTaskCreate(storage_space_task, "storage_task", 1024 * 3, NULL, tskIDLE_PRIORITY + 1, NULL);
+}
+
+uint32_t storage_space_clusters(uint64_t bytes) {
+  if (cluster_bytes == 0) {
+    return 0;
+  }
+  return (bytes + cluster_bytes - 1) / cluster_bytes;
+}
+
+// Writers report clusters they take or give back, negative values free space
+void storage_space_allocate(int32_t clusters) { __atomic_sub_fetch(&free_clusters, clusters, __ATOMIC_ACQ_REL); }
+
+// For changes nobody counted, the next parked reconcile picks them up
+void storage_space_invalidate() { is_dirty = true; }
+
+uint32_t storage_space_free_mb() {
+  int32_t clusters = __atomic_load_n(&free_clusters, __ATOMIC_ACQUIRE);
+  return clusters > 0 ? (uint64_t)clusters * cluster_bytes / (1024 * 1024) : 0;
+}
+
+uint32_t storage_space_total_mb() { return (uint64_t)total_clusters * cluster_bytes / (1024 * 1024); }
@@ -0,0 +1,17 @@
+#ifndef storage_space_h
+#define storage_space_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define STORAGE_RECONCILE_INTERVAL_MS (60 * 1000)
+#define STORAGE_RECONCILE_MAX_AGE_MS (30 * 60 * 1000)
+
+void storage_space_init();
+uint32_t storage_space_clusters(uint64_t bytes);
+void storage_space_allocate(int32_t clusters);
+void storage_space_invalidate();
+uint32_t storage_space_free_mb();
+uint32_t storage_space_total_mb();
+
+#endif
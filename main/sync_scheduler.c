@@ -0,0 +1,67 @@
+#include "sync_scheduler.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "service_settings.h"
+#include "settings.h"
+#include "state.h"
+#include "uploader.h"
+#include "wifi.h"
+#include <sys/param.h>
+
+static const char *TAG = "sync_scheduler";
+
+extern struct Settings settings;
+
+static int64_t next_attempt = 0;
+static uint32_t backoff_s = SYNC_SCAN_INTERVAL_MIN_S;
+
+// upload_interval, when set, caps the backoff so a device parked away from home still checks that often
+static uint32_t sync_scheduler_max_backoff_s() {
+  if (settings.upload_interval == 0) {
+    return SYNC_SCAN_INTERVAL_MAX_S;
+  }
+  return MAX(settings.upload_interval * 60, SYNC_SCAN_INTERVAL_MIN_S);
+}
+
+// Doubles the wait after every miss, randomized so devices parked together do not scan in lockstep
+static void sync_scheduler_backoff() {
+  uint32_t jitter = backoff_s * SYNC_JITTER_PERCENT / 100;
+  uint32_t delay_s = backoff_s - jitter + (jitter > 0 ? esp_random() % (2 * jitter + 1) : 0);
+
+  next_attempt = esp_timer_get_time() + (int64_t)delay_s * 1000 * 1000;
+  backoff_s = MIN(backoff_s * 2, sync_scheduler_max_backoff_s());
+  ESP_LOGI(TAG, "next attempt in %d s", delay_s);
+}
+
+// Radio stays off until a cheap passive scan sees one of the configured networks
+bool sync_scheduler_should_start() {
+  if (uploader_is_task_running() || wifi_get_state() != WIFI_DISABLED || esp_timer_get_time() < next_attempt) {
+    return false;
+  }
+  if (uploader_count_files_to_be_uploaded() == 0) {
+    return false;
+  }
+
+  int8_t profile = wifi_scan_for_client_networks();
+  if (profile < 0) {
+    sync_scheduler_backoff();
+    return false;
+  }
+
+  ESP_LOGI(TAG, "%s in range, rssi %d", settings.wifi_profiles[profile].ssid,
+           settings.wifi_profiles[profile].last_rssi);
+  return true;
+}
+
+void sync_scheduler_report(bool success) {
+  if (success) {
+    backoff_s = SYNC_SCAN_INTERVAL_MIN_S;
+    next_attempt = 0;
+    // keeps the last seen rssi of the profiles across reboots, written once per sync rather than per scan
+    settings_save();
+    settings_publish_wifi_profiles();
+  } else {
+    sync_scheduler_backoff();
+  }
+}
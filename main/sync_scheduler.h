@@ -0,0 +1,14 @@
+#ifndef sync_scheduler_h
+#define sync_scheduler_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SYNC_SCAN_INTERVAL_MIN_S 60
+#define SYNC_SCAN_INTERVAL_MAX_S (30 * 60)
+#define SYNC_JITTER_PERCENT 25
+
+bool sync_scheduler_should_start();
+void sync_scheduler_report(bool success);
+
+#endif
@@ -0,0 +1,235 @@
+#include "telemetry.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "log_shard.h"
+#include "logger.h"
+#include "sd_writer.h"
+#include "service_state.h"
+#include "state.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/param.h>
+
+static const char *TAG = "telemetry";
+
+extern struct Settings settings;
+
+#define TELEMETRY_ADC_RING_SIZE 128
+#define TELEMETRY_GPS_RING_SIZE 32
+#define TELEMETRY_BUFFER_SIZE 4096
+
+// Single producer single consumer ring, the producer only moves head and the consumer only moves tail
+struct TelemetryRing {
+  struct TelemetrySample *samples;
+  uint32_t mask;
+  uint32_t head;
+  uint32_t tail;
+  uint32_t dropped;
+};
+
+static struct TelemetrySample adc_samples[TELEMETRY_ADC_RING_SIZE];
+static struct TelemetrySample gps_samples[TELEMETRY_GPS_RING_SIZE];
+
+static struct TelemetryRing adc_ring = {.samples = adc_samples, .mask = TELEMETRY_ADC_RING_SIZE - 1};
+static struct TelemetryRing gps_ring = {.samples = gps_samples, .mask = TELEMETRY_GPS_RING_SIZE - 1};
+
+static struct TelemetrySample live_adc_samples[TELEMETRY_ADC_RING_SIZE];
+static struct TelemetrySample live_gps_samples[TELEMETRY_GPS_RING_SIZE];
+
+// Second pair of rings feeding the live stream, consumed independently of the card writer
+static struct TelemetryRing live_adc_ring = {.samples = live_adc_samples, .mask = TELEMETRY_ADC_RING_SIZE - 1};
+static struct TelemetryRing live_gps_ring = {.samples = live_gps_samples, .mask = TELEMETRY_GPS_RING_SIZE - 1};
+
+static bool is_active = false;
+static bool is_live = false;
+static uint8_t live_rate = 0;
+static int64_t start_time = 0;
+static struct SdWriterStream telemetry_stream;
+static char buffer[TELEMETRY_BUFFER_SIZE];
+
+struct TelemetryStats telemetry_stats;
+
+static bool telemetry_ring_push(struct TelemetryRing *ring, struct TelemetrySample *sample) {
+  uint32_t head = ring->head;
+  uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+  if (head - tail > ring->mask) {
+    ring->dropped++;
+    return false;
+  }
+
+  ring->samples[head & ring->mask] = *sample;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+static bool telemetry_ring_pop(struct TelemetryRing *ring, struct TelemetrySample *sample) {
+  uint32_t tail = ring->tail;
+  uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+  if (head == tail) {
+    return false;
+  }
+
+  *sample = ring->samples[tail & ring->mask];
+  __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+int telemetry_format(struct TelemetrySample *sample, char *line, size_t len) {
+  if (sample->type == TELEMETRY_SAMPLE_ADC) {
+    return snprintf(line, len, "A,%lld,%d,%d\n", sample->timestamp, sample->adc.current, sample->adc.voltage);
+  }
+  return snprintf(line, len, "G,%lld,%f,%f,%.2f,%.1f\n", sample->timestamp, sample->gps.latitude,
+                  sample->gps.longitude, sample->gps.speed, sample->gps.course);
+}
+
+// Sampling period of the adc loop, shortened while high rate telemetry is enabled
+uint16_t telemetry_interval_ms() {
+  uint8_t rate = MAX(settings.telemetry_rate, is_live ? live_rate : 0);
+  if (rate == 0) {
+    return TELEMETRY_DEFAULT_INTERVAL_MS;
+  }
+  return 1000 / MIN(MAX(rate, TELEMETRY_RATE_MIN), TELEMETRY_RATE_MAX);
+}
+
+bool telemetry_is_active() { return is_active; }
+bool telemetry_live_is_active() { return is_live; }
+
+// Called by the live stream consumer, the rings are only reset while producers skip them
+void telemetry_live_start(uint8_t rate) {
+  __atomic_store_n(&is_live, false, __ATOMIC_RELEASE);
+
+  live_adc_ring.tail = live_adc_ring.head;
+  live_adc_ring.dropped = 0;
+  live_gps_ring.tail = live_gps_ring.head;
+  live_gps_ring.dropped = 0;
+  live_rate = MIN(MAX(rate, TELEMETRY_RATE_MIN), TELEMETRY_RATE_MAX);
+
+  __atomic_store_n(&is_live, true, __ATOMIC_RELEASE);
+}
+
+void telemetry_live_stop() { __atomic_store_n(&is_live, false, __ATOMIC_RELEASE); }
+
+bool telemetry_live_pop(struct TelemetrySample *sample) {
+  return telemetry_ring_pop(&live_adc_ring, sample) || telemetry_ring_pop(&live_gps_ring, sample);
+}
+
+uint32_t telemetry_live_dropped() { return live_adc_ring.dropped + live_gps_ring.dropped; }
+
+void telemetry_start(const char *log_filename) {
+  if (settings.telemetry_rate == 0) {
+    return;
+  }
+
+  // kept under their own sharded root, these multi megabyte files are never uploaded as ride logs
+  char filename[TELEMETRY_FILENAME_MAX];
+  char telemetry_filename[TELEMETRY_FILENAME_MAX];
+  snprintf(filename, sizeof(filename), "telemetry%s", strchr(strrchr(log_filename, '/'), '.'));
+
+  log_shard_make_dirs(TELEMETRY_LOCATION, filename);
+  log_shard_path(telemetry_filename, sizeof(telemetry_filename), BASE_LOCATION TELEMETRY_LOCATION, filename);
+
+  // grows on demand, only the journaled ride log can be truncated back after a reset
+  if (!sd_writer_open(&telemetry_stream, telemetry_filename, 0)) {
+    return;
+  }
+
+  sd_writer_append(&telemetry_stream, TELEMETRY_HEADER, strlen(TELEMETRY_HEADER));
+
+  memset(&telemetry_stats, 0, sizeof(telemetry_stats));
+  adc_ring.tail = adc_ring.head;
+  adc_ring.dropped = 0;
+  gps_ring.tail = gps_ring.head;
+  gps_ring.dropped = 0;
+  start_time = esp_timer_get_time();
+
+  __atomic_store_n(&is_active, true, __ATOMIC_RELEASE);
+  ESP_LOGI(TAG, "Start telemetry %s at %d ms", telemetry_filename, telemetry_interval_ms());
+}
+
+void telemetry_add_adc(int64_t timestamp, int32_t current_ma, int32_t voltage_mv) {
+  if (!is_active && !is_live) {
+    return;
+  }
+
+  struct TelemetrySample sample = {.timestamp = timestamp, .type = TELEMETRY_SAMPLE_ADC};
+  sample.adc.current = current_ma;
+  sample.adc.voltage = voltage_mv;
+  if (is_active) {
+    telemetry_ring_push(&adc_ring, &sample);
+  }
+  if (is_live) {
+    telemetry_ring_push(&live_adc_ring, &sample);
+  }
+}
+
+void telemetry_add_gps(int64_t timestamp, double latitude, double longitude, float speed, float course) {
+  if (!is_active && !is_live) {
+    return;
+  }
+
+  struct TelemetrySample sample = {.timestamp = timestamp, .type = TELEMETRY_SAMPLE_GPS};
+  sample.gps.latitude = latitude;
+  sample.gps.longitude = longitude;
+  sample.gps.speed = speed;
+  sample.gps.course = course;
+  if (is_active) {
+    telemetry_ring_push(&gps_ring, &sample);
+  }
+  if (is_live) {
+    telemetry_ring_push(&live_gps_ring, &sample);
+  }
+}
+
+// Drains both rings into one buffered write, returns the number of samples taken
+static uint32_t telemetry_drain() {
+  struct TelemetrySample sample;
+  size_t length = 0;
+  uint32_t samples = 0;
+
+  while (length + TELEMETRY_LINE_MAX <= sizeof(buffer) &&
+         (telemetry_ring_pop(&adc_ring, &sample) || telemetry_ring_pop(&gps_ring, &sample))) {
+    length += MIN(telemetry_format(&sample, buffer + length, TELEMETRY_LINE_MAX), TELEMETRY_LINE_MAX - 1);
+    samples++;
+  }
+
+  sd_writer_reopen_if_failed(&telemetry_stream);
+  if (length > 0 && sd_writer_append(&telemetry_stream, buffer, length)) {
+    telemetry_stats.bytes += length;
+  }
+  sd_writer_flush_if_due(&telemetry_stream);
+  telemetry_stats.samples += samples;
+
+  int64_t elapsed = esp_timer_get_time() - start_time;
+  telemetry_stats.dropped_adc = adc_ring.dropped;
+  telemetry_stats.dropped_gps = gps_ring.dropped;
+  telemetry_stats.throughput = elapsed > 0 ? telemetry_stats.bytes * 1000000LL / elapsed : 0;
+
+  return samples;
+}
+
+void telemetry_flush() {
+  if (!is_active) {
+    return;
+  }
+
+  telemetry_drain();
+  state_telemetry_stats_update();
+}
+
+void telemetry_finish() {
+  if (!is_active) {
+    return;
+  }
+
+  __atomic_store_n(&is_active, false, __ATOMIC_RELEASE);
+
+  while (telemetry_drain() > 0) {
+  }
+  sd_writer_close(&telemetry_stream);
+  state_telemetry_stats_update();
+
+  ESP_LOGI(TAG, "%d samples %d bytes %d B/s dropped adc %d gps %d", telemetry_stats.samples, telemetry_stats.bytes,
+           telemetry_stats.throughput, telemetry_stats.dropped_adc, telemetry_stats.dropped_gps);
+}
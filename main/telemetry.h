@@ -0,0 +1,58 @@
+#ifndef telemetry_h
+#define telemetry_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TELEMETRY_FILENAME_MAX 80
+#define TELEMETRY_RATE_MIN 10
+#define TELEMETRY_RATE_MAX 50
+#define TELEMETRY_DEFAULT_INTERVAL_MS 50
+#define TELEMETRY_LINE_MAX 96
+#define TELEMETRY_HEADER "type,timestamp_us,current_ma|latitude,voltage_mv|longitude,speed,course\n"
+
+typedef enum { TELEMETRY_SAMPLE_ADC, TELEMETRY_SAMPLE_GPS } telemetry_sample_t;
+
+struct TelemetrySample {
+  int64_t timestamp;
+  uint8_t type;
+  union {
+    struct {
+      int32_t current;
+      int32_t voltage;
+    } adc;
+    struct {
+      double latitude;
+      double longitude;
+      float speed;
+      float course;
+    } gps;
+  };
+} __attribute__((packed));
+
+struct TelemetryStats {
+  uint32_t samples;
+  uint32_t dropped_adc;
+  uint32_t dropped_gps;
+  uint32_t bytes;
+  uint32_t throughput;
+} __attribute__((packed));
+
+uint16_t telemetry_interval_ms();
+bool telemetry_is_active();
+int telemetry_format(struct TelemetrySample *sample, char *line, size_t len);
+
+void telemetry_start(const char *log_filename);
+void telemetry_add_adc(int64_t timestamp, int32_t current_ma, int32_t voltage_mv);
+void telemetry_add_gps(int64_t timestamp, double latitude, double longitude, float speed, float course);
+void telemetry_flush();
+void telemetry_finish();
+
+bool telemetry_live_is_active();
+void telemetry_live_start(uint8_t rate);
+void telemetry_live_stop();
+bool telemetry_live_pop(struct TelemetrySample *sample);
+uint32_t telemetry_live_dropped();
+
+#endif
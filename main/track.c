@@ -0,0 +1,119 @@
+#include "track.h"
+#include "esp_log.h"
+#include "log_shard.h"
+#include "logger.h"
+#include "math.h"
+#include "sd_writer.h"
+#include "track_simplify.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/param.h>
+
+static const char *TAG = "track";
+
+#define d2r (M_PI / 180.0)
+#define EARTH_RADIUS_M 6367000.0
+
+#define TRACK_BUFFER_SIZE TRACK_SIMPLIFY_MAX_POINTS
+#define TRACK_TOLERANCE_M 3.0f
+#define TRACK_LINE_MAX 64
+#define TRACK_HEADER "timestamp,latitude,longitude\n"
+
+struct TrackPoint {
+  time_t timestamp;
+  double latitude;
+  double longitude;
+};
+
+static struct TrackPoint buffer[TRACK_BUFFER_SIZE];
+static struct TrackSimplifyPoint positions[TRACK_BUFFER_SIZE];
+static bool keep[TRACK_BUFFER_SIZE];
+static uint8_t buffer_count = 0;
+
+static char track_filename[TRACK_FILENAME_MAX];
+static struct SdWriterStream track_stream;
+static double origin_latitude;
+static double origin_longitude;
+static double meters_per_degree_longitude;
+static struct TrackSummary summary;
+
+static void track_flush(bool is_last) {
+  if (buffer_count == 0) {
+    return;
+  }
+
+  float deviation = track_simplify(positions, buffer_count, TRACK_TOLERANCE_M, keep);
+  if (deviation > summary.max_deviation) {
+    summary.max_deviation = deviation;
+  }
+
+  sd_writer_reopen_if_failed(&track_stream);
+
+  // last point is carried over as the first point of the next buffer
+  uint8_t count = is_last ? buffer_count : buffer_count - 1;
+  for (uint8_t i = 0; i < count; i++) {
+    if (keep[i]) {
+      char line[TRACK_LINE_MAX];
+      int length = snprintf(line, sizeof(line), "%ld,%f,%f\n", buffer[i].timestamp, buffer[i].latitude,
+                            buffer[i].longitude);
+      sd_writer_append(&track_stream, line, MIN(length, sizeof(line) - 1));
+      summary.kept_points++;
+    }
+  }
+  // a batch only comes every TRACK_BUFFER_SIZE fixes, holding on to the buffer meanwhile would starve telemetry
+  sd_writer_flush(&track_stream);
+
+  buffer[0] = buffer[buffer_count - 1];
+  positions[0] = positions[buffer_count - 1];
+  buffer_count = is_last ? 0 : 1;
+}
+
+// Tracks get their own sharded root so the uploader only ever sees ride and charge logs
+void track_start(const char *log_filename) {
+  char filename[TRACK_FILENAME_MAX];
+  snprintf(filename, sizeof(filename), "track%s", strchr(strrchr(log_filename, '/'), '.'));
+
+  log_shard_make_dirs(TRACKS_LOCATION, filename);
+  log_shard_path(track_filename, sizeof(track_filename), BASE_LOCATION TRACKS_LOCATION, filename);
+
+  memset(&summary, 0, sizeof(summary));
+  buffer_count = 0;
+
+  // grows on demand like telemetry, only the journaled ride log can be truncated back after a reset
+  sd_writer_open(&track_stream, track_filename, 0);
+  sd_writer_append(&track_stream, TRACK_HEADER, strlen(TRACK_HEADER));
+}
+
+void track_add_point(time_t timestamp, double latitude, double longitude) {
+  if (summary.points == 0) {
+    origin_latitude = latitude;
+    origin_longitude = longitude;
+    meters_per_degree_longitude = EARTH_RADIUS_M * d2r * cos(latitude * d2r);
+  }
+
+  struct TrackPoint *point = &buffer[buffer_count];
+  point->timestamp = timestamp;
+  point->latitude = latitude;
+  point->longitude = longitude;
+  positions[buffer_count].x = (longitude - origin_longitude) * meters_per_degree_longitude;
+  positions[buffer_count].y = (latitude - origin_latitude) * EARTH_RADIUS_M * d2r;
+  buffer_count++;
+  summary.points++;
+
+  if (buffer_count == TRACK_BUFFER_SIZE) {
+    track_flush(false);
+  }
+}
+
+void track_finish(struct TrackSummary *result) {
+  track_flush(true);
+  sd_writer_close(&track_stream);
+
+  ESP_LOGI(TAG, "track %s points %d kept %d max deviation %.2f m", track_filename, summary.points,
+           summary.kept_points, summary.max_deviation);
+
+  if (result != NULL) {
+    *result = summary;
+  }
+}
@@ -0,0 +1,19 @@
+#ifndef track_h
+#define track_h
+
+#include <stdint.h>
+#include <time.h>
+
+#define TRACK_FILENAME_MAX 80
+
+struct TrackSummary {
+  uint32_t points;
+  uint32_t kept_points;
+  float max_deviation;
+};
+
+void track_start(const char *log_filename);
+void track_add_point(time_t timestamp, double latitude, double longitude);
+void track_finish(struct TrackSummary *summary);
+
+#endif
@@ -0,0 +1,59 @@
+#include "track_simplify.h"
+#include <math.h>
+#include <string.h>
+
+static float track_segment_distance(const struct TrackSimplifyPoint *p, const struct TrackSimplifyPoint *a,
+                                    const struct TrackSimplifyPoint *b) {
+  float dx = b->x - a->x;
+  float dy = b->y - a->y;
+  float length2 = dx * dx + dy * dy;
+
+  if (length2 == 0) {
+    return sqrtf((p->x - a->x) * (p->x - a->x) + (p->y - a->y) * (p->y - a->y));
+  }
+
+  return fabsf(dy * p->x - dx * p->y + b->x * a->y - b->y * a->x) / sqrtf(length2);
+}
+
+// Iterative Douglas-Peucker, marks the points to keep and returns the largest deviation of a dropped one.
+// count has to be between 1 and TRACK_SIMPLIFY_MAX_POINTS, the first and last points are always kept
+float track_simplify(const struct TrackSimplifyPoint *points, uint8_t count, float tolerance, bool *keep) {
+  uint8_t stack[TRACK_SIMPLIFY_MAX_POINTS * 2];
+  uint8_t stack_size = 0;
+  float max_deviation = 0;
+
+  memset(keep, 0, count * sizeof(bool));
+  keep[0] = true;
+  keep[count - 1] = true;
+
+  stack[stack_size++] = 0;
+  stack[stack_size++] = count - 1;
+
+  while (stack_size > 0) {
+    uint8_t last = stack[--stack_size];
+    uint8_t first = stack[--stack_size];
+
+    float max_distance = 0;
+    uint8_t index = 0;
+
+    for (uint8_t i = first + 1; i < last; i++) {
+      float distance = track_segment_distance(&points[i], &points[first], &points[last]);
+      if (distance > max_distance) {
+        max_distance = distance;
+        index = i;
+      }
+    }
+
+    if (max_distance > tolerance) {
+      keep[index] = true;
+      stack[stack_size++] = first;
+      stack[stack_size++] = index;
+      stack[stack_size++] = index;
+      stack[stack_size++] = last;
+    } else if (max_distance > max_deviation) {
+      max_deviation = max_distance;
+    }
+  }
+
+  return max_deviation;
+}
@@ -0,0 +1,17 @@
+#ifndef track_simplify_h
+#define track_simplify_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TRACK_SIMPLIFY_MAX_POINTS 64
+
+// Local planar coordinates in meters
+struct TrackSimplifyPoint {
+  float x;
+  float y;
+};
+
+float track_simplify(const struct TrackSimplifyPoint *points, uint8_t count, float tolerance, bool *keep);
+
+#endif
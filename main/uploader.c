@@ -3,11 +3,16 @@
 #include "ff.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "log_export.h"
+#include "log_shard.h"
 #include "logger.h"
+#include "ride_index.h"
+#include "sync_scheduler.h"
 #include "wifi.h"
 
 #include "esp_http_client.h"
 #include "esp_tls.h"
+#include <string.h>
 
 #define ESK8PAL_UPLOAD_HOST_URL "esk8pal.wiklosoft.com"
 #define ESK8PAL_UPLOAD_PATH "/api/upload"
@@ -24,14 +29,8 @@ bool is_task_running = false;
 bool uploader_is_task_running() { return is_task_running; }
 
 bool uploader_wait_for_wifi() {
-  for (uint8_t i = 0; i < 5; i++) {
-    if (wifi_get_state() == WIFI_CLIENT_CONNECTED) {
-      return true;
-    }
-    vTaskDelay(2000 / portTICK_PERIOD_MS);
-    ESP_LOGI(TAG, "waiting for wifi");
-  }
-  return false;
+  ESP_LOGI(TAG, "waiting for wifi");
+  return wifi_wait_for_connection(WIFI_CONNECT_TIMEOUT_MS);
 }
 
 void uploader_sync() {
@@ -42,8 +41,10 @@ void uploader_sync() {
   if (files_to_be_uploaded > 0) {
     wifi_set_state(WIFI_CLIENT);
 
+    bool success = false;
     if (uploader_wait_for_wifi()) {
       uploader_sync_files();
+      success = uploader_count_files_to_be_uploaded() == 0;
 
       vTaskDelay(5 * 1000 / portTICK_PERIOD_MS);
       ESP_LOGI(TAG, "uploading finished");
@@ -51,73 +52,71 @@ void uploader_sync() {
       ESP_LOGI(TAG, "uploading failed");
     }
     wifi_set_state(WIFI_DISABLED);
+    sync_scheduler_report(success);
   }
 
   is_task_running = false;
   vTaskDelete(NULL);
 }
 
-uint16_t uploader_count_files_to_be_uploaded() {
-  FRESULT res;
-  FILINFO file;
-  FF_DIR dir;
-  uint16_t count = 0;
+// Only ride and charge logs go to the upload endpoint, anything else left in the logs folder is skipped
+static bool uploader_is_log_file(const char *name) {
+  return strncmp(name, "log.", 4) == 0 || strncmp(name, "charge.", 7) == 0;
+}
 
-  if (f_opendir(&dir, LOGS_LOCATION) != FR_OK) {
-    ESP_LOGE(TAG, "Failed to create folder %s", LOGS_LOCATION);
-    return 0;
+static bool uploader_count_file(const char *dir, FILINFO *file, void *context) {
+  if (uploader_is_log_file(file->fname)) {
+    (*(uint16_t *)context)++;
   }
+  return true;
+}
 
-  for (;;) {
-    res = f_readdir(&dir, &file);
-    if (res != FR_OK || file.fname[0] == 0)
-      break;
-    count++;
-  }
+uint16_t uploader_count_files_to_be_uploaded() {
+  uint16_t count = 0;
 
-  f_closedir(&dir);
+  log_shard_walk(LOGS_LOCATION, uploader_count_file, &count);
 
   return count;
 }
 
-void uploader_sync_files() {
-  FRESULT res;
-  FILINFO file;
-  FF_DIR dir;
+static bool uploader_sync_file(const char *dir, FILINFO *file, void *context) {
+  char filename[LOG_FILENAME_MAX];
+  char synced_filename[LOG_FILENAME_MAX];
+  char synced_path[LOG_SHARD_PATH_MAX];
 
-  if (f_opendir(&dir, LOGS_LOCATION) != FR_OK) {
-    ESP_LOGE(TAG, "Failed to create folder %s", LOGS_LOCATION);
-    return;
+  if (!uploader_is_log_file(file->fname)) {
+    return true;
   }
 
-  char filename[270];
-  char synced_filename[280];
+  snprintf(filename, sizeof(filename), "%s%s/%s", BASE_LOCATION, dir, file->fname);
 
-  for (;;) {
-    res = f_readdir(&dir, &file);
-    if (res != FR_OK || file.fname[0] == 0)
-      break;
+  if (uploader_upload_file(filename, file->fsize)) {
+    ESP_LOGI(TAG, "Synced file %s %d", file->fname, file->fsize);
 
-    sprintf(filename, "%s%s/%s", BASE_LOCATION, LOGS_LOCATION, file.fname);
+    log_shard_make_dirs(SYNCED_LOGS_LOCATION, file->fname);
+    log_shard_path(synced_path, sizeof(synced_path), SYNCED_LOGS_LOCATION, file->fname);
+    snprintf(synced_filename, sizeof(synced_filename), "%s%s", BASE_LOCATION, synced_path);
 
-    if (uploader_upload_file(filename, file.fsize)) {
-      ESP_LOGI(TAG, "Synced file %s %d", file.fname, file.fsize);
-      sprintf(synced_filename, "%s%s/%s", BASE_LOCATION, SYNCED_LOGS_LOCATION, file.fname);
+    int res = rename(filename, synced_filename);
+    ESP_LOGI(TAG, "rename  %s %s %d ", filename, synced_filename, res);
 
-      res = rename(filename, synced_filename);
-      ESP_LOGI(TAG, "rename  %s %s %d ", filename, synced_filename, res);
-    }
+    ride_index_mark_synced(file->fname);
   }
-
-  f_closedir(&dir);
+  return true;
 }
 
+void uploader_sync_files() { log_shard_walk(LOGS_LOCATION, uploader_sync_file, NULL); }
+
+// Binary logs are converted to csv while uploading so the server keeps receiving the same columns
 bool uploader_upload_file(char *filename, size_t size) {
-  FILE *f = fopen(filename, "r");
-  if (f == NULL) {
+  struct LogExport export;
+  if (!log_export_open(&export, filename, LOG_EXPORT_CSV)) {
     ESP_LOGE(TAG, "Failed to open file for reading");
     return false;
   }
+  if (export.is_binary) {
+    size = log_export_size(filename, LOG_EXPORT_CSV);
+  }
 
   char request_url[100];
 
@@ -157,13 +156,9 @@ bool uploader_upload_file(char *filename, size_t size) {
   esp_http_client_write(client, post_data_start2, strlen(post_data_start2));
 
   char chunk[1024];
-  while (1) {
-    size_t len = fread(chunk, 1, sizeof(chunk), f);
+  size_t len;
+  while ((len = log_export_read(&export, chunk, sizeof(chunk))) > 0) {
     esp_http_client_write(client, chunk, len);
-
-    if (len < 1024) {
-      break;
-    }
   }
 
   esp_http_client_write(client, "\r\n", 2);
@@ -178,7 +173,7 @@ bool uploader_upload_file(char *filename, size_t size) {
   esp_http_client_close(client);
   esp_http_client_cleanup(client);
 
-  fclose(f);
+  log_export_close(&export);
 
   return responseCode == 200;
 }
@@ -1,15 +1,138 @@
 #include "wifi.h"
+#include "http_server.h"
+#include "logger.h"
+#include "esp_timer.h"
 #include "state.h"
+#include <sys/param.h>
 
 extern struct CurrentState state;
 extern struct Settings settings;
 
 static const char *TAG = "WiFi";
 
+#define KEY_WIFI_CACHE "wifi_cache"
+
+// Access point of the last successful connection, lets the next one skip the full channel scan
+struct WifiConnectCache {
+  uint8_t ssid[21];
+  uint8_t bssid[6];
+  uint8_t channel;
+} __attribute__((packed));
+
 wifi_state_t current_state = WIFI_DISABLED;
 
 static int s_retry_num = 0;
 
+static EventGroupHandle_t wifi_event_group = NULL;
+static struct WifiConnectCache connect_cache;
+static bool is_using_cache = false;
+static bool is_scanning = false;
+static int8_t selected_profile = -1;
+static wifi_ap_record_t scan_records[WIFI_SCAN_MAX_RECORDS];
+static int64_t connect_start = 0;
+
+// Profile picked by the last scan, or the highest priority configured one when nothing was scanned
+static struct WifiProfile *wifi_client_profile() {
+  if (selected_profile >= 0 && settings.wifi_profiles[selected_profile].ssid[0] != 0) {
+    return &settings.wifi_profiles[selected_profile];
+  }
+
+  struct WifiProfile *best = &settings.wifi_profiles[0];
+  for (uint8_t i = 1; i < WIFI_PROFILE_COUNT; i++) {
+    struct WifiProfile *profile = &settings.wifi_profiles[i];
+    if (profile->ssid[0] != 0 && (best->ssid[0] == 0 || profile->priority > best->priority)) {
+      best = profile;
+    }
+  }
+  return best;
+}
+
+static bool wifi_load_cache() {
+  nvs_handle_t handle;
+  size_t len = sizeof(connect_cache);
+  bool loaded = false;
+
+  if (nvs_open("storage", NVS_READONLY, &handle) == ESP_OK) {
+    loaded = nvs_get_blob(handle, KEY_WIFI_CACHE, &connect_cache, &len) == ESP_OK && len == sizeof(connect_cache);
+    nvs_close(handle);
+  }
+  return loaded;
+}
+
+static bool wifi_cache_matches(struct WifiProfile *profile) {
+  return strncmp((char *)connect_cache.ssid, (char *)profile->ssid, sizeof(connect_cache.ssid)) == 0;
+}
+
+static void wifi_save_cache(struct WifiConnectCache *cache) {
+  nvs_handle_t handle;
+
+  if (nvs_open("storage", NVS_READWRITE, &handle) == ESP_OK) {
+    nvs_set_blob(handle, KEY_WIFI_CACHE, cache, sizeof(struct WifiConnectCache));
+    nvs_commit(handle);
+    nvs_close(handle);
+  }
+}
+
+// Only written when the access point changed, so a steady home network costs no flash writes
+static void wifi_update_cache() {
+  wifi_ap_record_t ap_info;
+  if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK) {
+    return;
+  }
+
+  struct WifiConnectCache cache = {.channel = ap_info.primary};
+  memcpy(cache.ssid, wifi_client_profile()->ssid, sizeof(cache.ssid));
+  memcpy(cache.bssid, ap_info.bssid, sizeof(cache.bssid));
+
+  if (memcmp(&cache, &connect_cache, sizeof(cache)) != 0) {
+    connect_cache = cache;
+    wifi_save_cache(&cache);
+    ESP_LOGI(TAG, "cached " MACSTR " channel %d", MAC2STR(cache.bssid), cache.channel);
+  }
+}
+
+static void wifi_apply_static_ip() {
+  tcpip_adapter_ip_info_t ip_info = {
+      .ip = {.addr = settings.static_ip.ip},
+      .netmask = {.addr = settings.static_ip.netmask},
+      .gw = {.addr = settings.static_ip.gateway},
+  };
+  tcpip_adapter_set_ip_info(TCPIP_ADAPTER_IF_STA, &ip_info);
+
+  if (settings.static_ip.dns != 0) {
+    tcpip_adapter_dns_info_t dns_info = {0};
+    dns_info.ip.u_addr.ip4.addr = settings.static_ip.dns;
+    dns_info.ip.type = IPADDR_TYPE_V4;
+    tcpip_adapter_set_dns_info(TCPIP_ADAPTER_IF_STA, TCPIP_ADAPTER_DNS_MAIN, &dns_info);
+  }
+}
+
+static void wifi_configure_sta(bool use_cache) {
+  wifi_config_t wifi_config = {
+      .sta =
+          {
+              .pmf_cfg = {.capable = true, .required = false},
+          },
+  };
+
+  struct WifiProfile *profile = wifi_client_profile();
+  memcpy(wifi_config.sta.ssid, profile->ssid, strnlen((char *)profile->ssid, sizeof(profile->ssid)));
+  memcpy(wifi_config.sta.password, profile->pass, strnlen((char *)profile->pass, sizeof(profile->pass)));
+
+  is_using_cache = use_cache;
+  if (use_cache) {
+    wifi_config.sta.bssid_set = true;
+    memcpy(wifi_config.sta.bssid, connect_cache.bssid, sizeof(connect_cache.bssid));
+    wifi_config.sta.channel = connect_cache.channel;
+    wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+  } else {
+    wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+    wifi_config.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+  }
+
+  ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config));
+}
+
 static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
   if (event_id == WIFI_EVENT_AP_STACONNECTED) {
     wifi_event_ap_staconnected_t *event = (wifi_event_ap_staconnected_t *)event_data;
@@ -20,19 +143,43 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
   }
 
   if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-    esp_wifi_connect();
+    if (!is_scanning) {
+      esp_wifi_connect();
+    }
+  } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+    if (settings.static_ip.ip != 0) {
+      wifi_apply_static_ip();
+    }
   } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-    if (s_retry_num < 5) {
+    if (current_state == WIFI_DISABLED) {
+      return;
+    }
+    if (current_state == WIFI_CLIENT_CONNECTED) {
+      current_state = WIFI_CLIENT;
+    }
+    xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT);
+
+    if (is_using_cache) {
+      // the cached access point is gone or moved channel, fall back to a full scan
+      ESP_LOGI(TAG, "cached AP failed, scanning");
+      wifi_configure_sta(false);
+      esp_wifi_connect();
+    } else if (s_retry_num < 5) {
       esp_wifi_connect();
       s_retry_num++;
       ESP_LOGI(TAG, "retry to connect to the AP");
+    } else {
+      ESP_LOGI(TAG, "connect to the AP fail");
+      xEventGroupSetBits(wifi_event_group, WIFI_FAIL_BIT);
     }
-    ESP_LOGI(TAG, "connect to the AP fail");
   } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
     ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
-    ESP_LOGI(TAG, "got ip:%s", ip4addr_ntoa(&event->ip_info.ip));
+    ESP_LOGI(TAG, "got ip:%s in %lld ms", ip4addr_ntoa(&event->ip_info.ip),
+             (esp_timer_get_time() - connect_start) / 1000);
     s_retry_num = 0;
     current_state = WIFI_CLIENT_CONNECTED;
+    wifi_update_cache();
+    xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
   }
 }
 
@@ -50,23 +197,26 @@ void wifi_init_softap() {
   ESP_ERROR_CHECK(esp_wifi_start());
 }
 
+// Goes straight to the cached BSSID and channel when there is one, DHCP resumes the previous lease
+// (CONFIG_LWIP_DHCP_RESTORE_LAST_IP) unless a static address is configured
 void wifi_init_sta() {
-  wifi_config_t wifi_config = {
-      .sta =
-          {
-              .pmf_cfg = {.capable = true, .required = false},
-          },
-  };
+  connect_start = esp_timer_get_time();
+  s_retry_num = 0;
+  xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
 
-  memcpy(wifi_config.sta.ssid, settings.wifi_ssid_client, strlen((char *)settings.wifi_ssid_client));
-  memcpy(wifi_config.sta.password, settings.wifi_pass_client, strlen((char *)settings.wifi_pass_client));
+  if (settings.static_ip.ip != 0) {
+    tcpip_adapter_dhcpc_stop(TCPIP_ADAPTER_IF_STA);
+  } else {
+    tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA);
+  }
 
   ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-  ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config));
+  wifi_configure_sta(wifi_load_cache() && wifi_cache_matches(wifi_client_profile()));
   ESP_ERROR_CHECK(esp_wifi_start());
 }
 
 void wifi_init() {
+  wifi_event_group = xEventGroupCreate();
   tcpip_adapter_init();
   ESP_ERROR_CHECK(esp_event_loop_create_default());
 
@@ -79,11 +229,93 @@ void wifi_init() {
 
 wifi_state_t wifi_get_state() { return current_state; }
 
+// Records the strongest signal of every profile seen and picks the highest priority one, rssi breaks ties
+static int8_t wifi_select_profile(uint16_t count) {
+  int8_t selected = -1;
+
+  for (uint8_t i = 0; i < WIFI_PROFILE_COUNT; i++) {
+    struct WifiProfile *profile = &settings.wifi_profiles[i];
+    bool is_seen = false;
+    int8_t rssi = INT8_MIN;
+
+    for (uint16_t j = 0; j < count && profile->ssid[0] != 0; j++) {
+      if (strncmp((char *)scan_records[j].ssid, (char *)profile->ssid, sizeof(profile->ssid)) == 0) {
+        is_seen = true;
+        rssi = MAX(rssi, scan_records[j].rssi);
+      }
+    }
+    if (!is_seen) {
+      continue;
+    }
+
+    profile->last_rssi = rssi;
+    struct WifiProfile *best = selected >= 0 ? &settings.wifi_profiles[selected] : NULL;
+    if (best == NULL || profile->priority > best->priority ||
+        (profile->priority == best->priority && rssi > best->last_rssi)) {
+      selected = i;
+    }
+  }
+  return selected;
+}
+
+// One passive scan without associating covers every profile. The cached channel is listened to first, a hit
+// there only ends the scan when no configured profile has a higher priority, otherwise all channels are scanned
+// so the best network in range wins. Only used while wifi is disabled, returns the selected profile index or -1
+int8_t wifi_scan_for_client_networks() {
+  bool has_profiles = false;
+  uint8_t max_priority = 0;
+  for (uint8_t i = 0; i < WIFI_PROFILE_COUNT; i++) {
+    if (settings.wifi_profiles[i].ssid[0] != 0) {
+      has_profiles = true;
+      max_priority = MAX(max_priority, settings.wifi_profiles[i].priority);
+    }
+  }
+  if (current_state != WIFI_DISABLED || !has_profiles) {
+    return -1;
+  }
+
+  is_scanning = true;
+  ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+  ESP_ERROR_CHECK(esp_wifi_start());
+
+  wifi_scan_config_t scan_config = {
+      .scan_type = WIFI_SCAN_TYPE_PASSIVE,
+      .scan_time = {.passive = WIFI_SCAN_PASSIVE_DWELL_MS},
+  };
+
+  selected_profile = -1;
+  uint8_t channels[2] = {wifi_load_cache() ? connect_cache.channel : 0, 0};
+  for (uint8_t i = channels[0] == 0 ? 1 : 0; i < 2; i++) {
+    uint16_t count = WIFI_SCAN_MAX_RECORDS;
+    scan_config.channel = channels[i];
+    if (esp_wifi_scan_start(&scan_config, true) != ESP_OK ||
+        esp_wifi_scan_get_ap_records(&count, scan_records) != ESP_OK) {
+      count = 0;
+    }
+    selected_profile = wifi_select_profile(count);
+
+    if (selected_profile >= 0 && settings.wifi_profiles[selected_profile].priority == max_priority) {
+      break;
+    }
+  }
+
+  esp_wifi_stop();
+  is_scanning = false;
+  return selected_profile;
+}
+
+bool wifi_wait_for_connection(uint32_t timeout_ms) {
+  EventBits_t bits = xEventGroupWaitBits(wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT, pdFALSE, pdFALSE,
+                                         timeout_ms / portTICK_PERIOD_MS);
+  return (bits & WIFI_CONNECTED_BIT) != 0;
+}
+
 void wifi_set_state(wifi_state_t state) {
   if (state == WIFI_AP) {
     if (current_state != WIFI_AP) {
       wifi_init_softap();
       current_state = WIFI_AP;
+      start_file_server(BASE_LOCATION);
     }
   } else if (state == WIFI_CLIENT) {
     if (current_state != WIFI_CLIENT && current_state != WIFI_CLIENT_CONNECTED) {
@@ -92,9 +324,10 @@ void wifi_set_state(wifi_state_t state) {
     }
   } else {
     if (current_state != WIFI_DISABLED) {
+      current_state = WIFI_DISABLED;
       esp_wifi_disconnect();
       esp_wifi_stop();
-      current_state = WIFI_DISABLED;
+      xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
     }
   }
 }
@@ -6,6 +6,7 @@
 #include "esp_system.h"
 #include "esp_wifi.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
 #include "freertos/task.h"
 #include "nvs_flash.h"
 #include <string.h>
@@ -14,8 +15,16 @@
 #include "lwip/sys.h"
 #include "state.h"
 
+#define WIFI_CONNECTED_BIT BIT0
+#define WIFI_FAIL_BIT BIT1
+#define WIFI_CONNECT_TIMEOUT_MS 10000
+#define WIFI_SCAN_PASSIVE_DWELL_MS 120
+#define WIFI_SCAN_MAX_RECORDS 16
+
 void wifi_init();
 void wifi_set_state(wifi_state_t state);
 wifi_state_t wifi_get_state();
+bool wifi_wait_for_connection(uint32_t timeout_ms);
+int8_t wifi_scan_for_client_networks();
 
 #endif
\ No newline at end of file
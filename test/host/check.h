@@ -0,0 +1,41 @@
+#ifndef check_h
+#define check_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Minimal assertions for the host checks, a failure is reported and the run goes on so every check is listed
+static int check_failures = 0;
+
+#define CHECK(condition)                                                                                               \
+  do {                                                                                                                 \
+    if (!(condition)) {                                                                                                \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);                                            \
+      check_failures++;                                                                                                \
+    }                                                                                                                  \
+  } while (0)
+
+#define CHECK_STRING(actual, expected)                                                                                 \
+  do {                                                                                                                 \
+    if (strcmp((actual), (expected)) != 0) {                                                                           \
+      printf("%s:%d: expected \"%s\" got \"%s\"\n", __FILE__, __LINE__, (expected), (actual));                         \
+      check_failures++;                                                                                                \
+    }                                                                                                                  \
+  } while (0)
+
+#define CHECK_RESULT()                                                                                                 \
+  do {                                                                                                                 \
+    printf("%s: %s\n", __FILE__, check_failures == 0 ? "OK" : "FAILED");                                               \
+    return check_failures == 0 ? 0 : 1;                                                                                \
+  } while (0)
+
+// Monotonic clock for the host benchmarks, these only report timings and never fail a run
+static inline int64_t check_now_ns() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef crc_h
+#define crc_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint32_t crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef esp_err_h
+#define esp_err_h
+
+// Just enough of ESP-IDF for the modules the host checks build
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_SIZE 0x104
+
+const char *esp_err_to_name(esp_err_t code);
+
+#endif
@@ -0,0 +1,82 @@
+#include "esp_partition.h"
+#include "esp32/rom/crc.h"
+#include <string.h>
+
+static uint8_t flash[FLASH_SHIM_SECTOR_SIZE * FLASH_SHIM_SECTOR_COUNT];
+static const esp_partition_t partition = {.address = 0, .size = sizeof(flash), .label = "ridelog"};
+
+static int32_t program_budget = FLASH_SHIM_UNLIMITED;
+static uint32_t program_errors = 0;
+
+const char *esp_err_to_name(esp_err_t code) { return code == ESP_OK ? "ESP_OK" : "ESP_FAIL"; }
+
+// Same polynomial and inversion as the ROM routine
+uint32_t crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+  crc = ~crc;
+  for (uint32_t i = 0; i < len; i++) {
+    crc ^= buf[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
+
+void flash_shim_reset() {
+  memset(flash, 0xFF, sizeof(flash));
+  program_budget = FLASH_SHIM_UNLIMITED;
+  program_errors = 0;
+}
+
+void flash_shim_set_program_budget(int32_t budget) { program_budget = budget; }
+
+uint32_t flash_shim_get_program_errors() { return program_errors; }
+
+uint8_t *flash_shim_get_data() { return flash; }
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label) {
+  return strcmp(label, partition.label) == 0 ? &partition : NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size) {
+  if (src_offset + size > partition->size) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  memcpy(dst, flash + src_offset, size);
+  return ESP_OK;
+}
+
+// Setting a bit that is already cleared needs an erase first, the real chip would silently keep the 0
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size) {
+  if (dst_offset + size > partition->size) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  for (size_t i = 0; i < size; i++) {
+    if (program_budget == 0) {
+      break;
+    }
+    if (program_budget > 0) {
+      program_budget--;
+    }
+
+    uint8_t value = ((const uint8_t *)src)[i];
+    if ((flash[dst_offset + i] & value) != value) {
+      program_errors++;
+    }
+    flash[dst_offset + i] &= value;
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+  if (offset % FLASH_SHIM_SECTOR_SIZE != 0 || size % FLASH_SHIM_SECTOR_SIZE != 0 || offset + size > partition->size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (program_budget == 0) {
+    return ESP_OK;
+  }
+  memset(flash + offset, 0xFF, size);
+  return ESP_OK;
+}
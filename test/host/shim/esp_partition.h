@@ -0,0 +1,38 @@
+#ifndef esp_partition_h
+#define esp_partition_h
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ESP_PARTITION_TYPE_DATA 0x01
+#define ESP_PARTITION_SUBTYPE_ANY 0xff
+
+#define FLASH_SHIM_SECTOR_SIZE 4096
+#define FLASH_SHIM_SECTOR_COUNT 4
+#define FLASH_SHIM_UNLIMITED -1
+
+typedef int esp_partition_type_t;
+typedef int esp_partition_subtype_t;
+
+typedef struct {
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+} esp_partition_t;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size);
+
+// RAM backed NOR flash: erase sets bytes to 0xFF, programming can only clear bits. A power loss is simulated by
+// letting only the next budget bytes be programmed, everything after that is silently dropped
+void flash_shim_reset();
+void flash_shim_set_program_budget(int32_t budget);
+uint32_t flash_shim_get_program_errors();
+uint8_t *flash_shim_get_data();
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef esp_timer_h
+#define esp_timer_h
+
+#include <stdint.h>
+
+// Simulated clock, it only moves when a shim charges time for an operation
+int64_t esp_timer_get_time();
+void esp_timer_shim_advance(int64_t time_us);
+
+#endif
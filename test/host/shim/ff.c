@@ -0,0 +1,184 @@
+#include "ff.h"
+#include "esp_timer.h"
+#include <string.h>
+
+// FAT32 entries per FAT sector, and the volume keeps two copies of the FAT
+#define FAT_ENTRIES_PER_SECTOR (FF_SS_SDCARD / 4)
+#define FAT_COPIES 2
+
+static bool is_used[FF_SHIM_CLUSTER_COUNT];
+static uint32_t last_allocated = 0;
+static uint32_t fat_writes = 0;
+
+static void ff_shim_read_sectors(uint32_t count) { esp_timer_shim_advance(count * FF_SHIM_SECTOR_READ_US); }
+
+static void ff_shim_write_sectors(uint32_t count) { esp_timer_shim_advance(count * FF_SHIM_SECTOR_WRITE_US); }
+
+static void ff_shim_write_fat(uint32_t sectors) {
+  fat_writes += sectors * FAT_COPIES;
+  ff_shim_write_sectors(sectors * FAT_COPIES);
+}
+
+static uint32_t ff_shim_random(uint32_t *seed) {
+  *seed = *seed * 1664525 + 1013904223;
+  return *seed >> 8;
+}
+
+void ff_shim_format(uint8_t used_percent, uint16_t run_clusters, uint32_t seed) {
+  uint32_t cluster = 0;
+
+  while (cluster < FF_SHIM_CLUSTER_COUNT) {
+    bool is_run_used = ff_shim_random(&seed) % 100 < used_percent;
+    uint32_t length = ff_shim_random(&seed) % run_clusters + 1;
+    for (uint32_t i = 0; i < length && cluster < FF_SHIM_CLUSTER_COUNT; i++) {
+      is_used[cluster++] = is_run_used;
+    }
+  }
+  last_allocated = 0;
+  fat_writes = 0;
+}
+
+void ff_shim_limit_free_clusters(uint32_t count) {
+  for (uint32_t i = 0; i < FF_SHIM_CLUSTER_COUNT; i++) {
+    is_used[i] = i >= count;
+  }
+  last_allocated = 0;
+  fat_writes = 0;
+}
+
+uint32_t ff_shim_get_free_clusters() {
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < FF_SHIM_CLUSTER_COUNT; i++) {
+    count += !is_used[i];
+  }
+  return count;
+}
+
+uint32_t ff_shim_get_fat_writes() { return fat_writes; }
+
+// Like FatFs, the search for a free cluster continues after the last one handed out and reads the FAT as it goes
+static bool ff_shim_allocate(FIL *fp) {
+  if (fp->cluster_count == FF_SHIM_FILE_CLUSTERS) {
+    return false;
+  }
+
+  for (uint32_t i = 1; i <= FF_SHIM_CLUSTER_COUNT; i++) {
+    uint32_t cluster = (last_allocated + i) % FF_SHIM_CLUSTER_COUNT;
+    if (!is_used[cluster]) {
+      ff_shim_read_sectors(i / FAT_ENTRIES_PER_SECTOR + 1);
+      is_used[cluster] = true;
+      last_allocated = cluster;
+      fp->clusters[fp->cluster_count++] = cluster;
+      fp->is_fat_dirty = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void ff_shim_release(FIL *fp, uint32_t keep) {
+  while (fp->cluster_count > keep) {
+    is_used[fp->clusters[--fp->cluster_count]] = false;
+    fp->is_fat_dirty = true;
+  }
+}
+
+// The shim keeps no directory, every open creates an empty file and there is nothing to append to
+FRESULT f_open(FIL *fp, const char *path, BYTE mode) {
+  memset(fp, 0, sizeof(FIL));
+  if ((mode & FA_OPEN_APPEND) == FA_OPEN_APPEND) {
+    return FR_NO_FILE;
+  }
+  // directory lookup and the new entry
+  ff_shim_read_sectors(1);
+  ff_shim_write_sectors(1);
+  return FR_OK;
+}
+
+// Data goes through the sector buffer of the FIL, a sector is written once the position leaves it
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw) {
+  *bw = 0;
+
+  for (UINT i = 0; i < btw; i++) {
+    if (fp->position / FF_SHIM_CLUSTER_SIZE >= fp->cluster_count && !ff_shim_allocate(fp)) {
+      return FR_DENIED;
+    }
+    fp->position++;
+    fp->is_data_dirty = true;
+    if (fp->position % FF_SS_SDCARD == 0) {
+      ff_shim_write_sectors(1);
+      fp->is_data_dirty = false;
+    }
+    (*bw)++;
+  }
+
+  if (fp->position > fp->size) {
+    fp->size = fp->position;
+  }
+  return FR_OK;
+}
+
+// Dirty data sector, changed FAT sectors and the directory entry with the new size
+FRESULT f_sync(FIL *fp) {
+  if (fp->is_data_dirty) {
+    ff_shim_write_sectors(1);
+    fp->is_data_dirty = false;
+  }
+  if (fp->is_fat_dirty) {
+    ff_shim_write_fat(1);
+    fp->is_fat_dirty = false;
+  }
+  ff_shim_read_sectors(1);
+  ff_shim_write_sectors(1);
+  return FR_OK;
+}
+
+// Moving within the allocated clusters, the dirty sector is written before the position leaves it
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs) {
+  if (ofs > fp->size) {
+    return FR_DENIED;
+  }
+  if (fp->is_data_dirty) {
+    ff_shim_write_sectors(1);
+    fp->is_data_dirty = false;
+  }
+  fp->position = ofs;
+  return FR_OK;
+}
+
+// Looks for a free run of clusters large enough for fsz and links it in one go, the file size is set to fsz
+FRESULT f_expand(FIL *fp, FSIZE_t fsz, BYTE opt) {
+  uint32_t needed = (fsz + FF_SHIM_CLUSTER_SIZE - 1) / FF_SHIM_CLUSTER_SIZE;
+  uint32_t run = 0;
+
+  if (fp->cluster_count != 0 || needed > FF_SHIM_FILE_CLUSTERS) {
+    return FR_DENIED;
+  }
+
+  for (uint32_t cluster = 0; cluster < FF_SHIM_CLUSTER_COUNT; cluster++) {
+    run = is_used[cluster] ? 0 : run + 1;
+    if (run == needed) {
+      ff_shim_read_sectors(cluster / FAT_ENTRIES_PER_SECTOR + 1);
+      for (uint32_t i = 0; i < needed; i++) {
+        fp->clusters[i] = cluster + 1 - needed + i;
+        is_used[fp->clusters[i]] = true;
+      }
+      fp->cluster_count = needed;
+      fp->size = fsz;
+      ff_shim_write_fat(needed / FAT_ENTRIES_PER_SECTOR + 1);
+      return FR_OK;
+    }
+  }
+
+  ff_shim_read_sectors(FF_SHIM_CLUSTER_COUNT / FAT_ENTRIES_PER_SECTOR);
+  return FR_DENIED;
+}
+
+// Cuts the file at the current position and frees the clusters past it
+FRESULT f_truncate(FIL *fp) {
+  fp->size = fp->position;
+  ff_shim_release(fp, (fp->size + FF_SHIM_CLUSTER_SIZE - 1) / FF_SHIM_CLUSTER_SIZE);
+  return f_sync(fp);
+}
+
+FRESULT f_close(FIL *fp) { return f_sync(fp); }
@@ -0,0 +1,66 @@
+#ifndef ff_h
+#define ff_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// FatFs file calls over a simulated FAT32 volume. Nothing is stored, the shim tracks the cluster chain of each file
+// and charges the simulated clock for the sector reads and writes FatFs would do on an SD card
+typedef unsigned int UINT;
+typedef uint8_t BYTE;
+typedef uint32_t DWORD;
+typedef uint32_t FSIZE_t;
+
+typedef enum {
+  FR_OK = 0,
+  FR_DISK_ERR,
+  FR_INT_ERR,
+  FR_NOT_READY,
+  FR_NO_FILE,
+  FR_NO_PATH,
+  FR_INVALID_NAME,
+  FR_DENIED,
+} FRESULT;
+
+#define FA_READ 0x01
+#define FA_WRITE 0x02
+#define FA_CREATE_ALWAYS 0x08
+#define FA_OPEN_APPEND 0x30
+
+#define FF_SS_SDCARD 512
+
+#define FF_SHIM_CLUSTER_SIZE (16 * 1024)
+#define FF_SHIM_CLUSTER_COUNT 8192
+#define FF_SHIM_FILE_CLUSTERS 512
+#define FF_SHIM_SECTOR_READ_US 200
+#define FF_SHIM_SECTOR_WRITE_US 800
+
+typedef struct {
+  FSIZE_t size;
+  FSIZE_t position;
+  uint32_t clusters[FF_SHIM_FILE_CLUSTERS];
+  uint32_t cluster_count;
+  bool is_fat_dirty;
+  bool is_data_dirty;
+} FIL;
+
+#define f_size(fp) ((fp)->size)
+#define f_tell(fp) ((fp)->position)
+
+FRESULT f_open(FIL *fp, const char *path, BYTE mode);
+FRESULT f_write(FIL *fp, const void *buff, UINT btw, UINT *bw);
+FRESULT f_sync(FIL *fp);
+FRESULT f_lseek(FIL *fp, FSIZE_t ofs);
+FRESULT f_expand(FIL *fp, FSIZE_t fsz, BYTE opt);
+FRESULT f_truncate(FIL *fp);
+FRESULT f_close(FIL *fp);
+
+// Fills the volume with runs of 1 to run_clusters clusters, used_percent of them taken by other files like a card
+// after months of rides
+void ff_shim_format(uint8_t used_percent, uint16_t run_clusters, uint32_t seed);
+// Leaves only the first count clusters free, for running out of space mid-file
+void ff_shim_limit_free_clusters(uint32_t count);
+uint32_t ff_shim_get_free_clusters();
+uint32_t ff_shim_get_fat_writes();
+
+#endif
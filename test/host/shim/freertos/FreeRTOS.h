@@ -0,0 +1,6 @@
+#ifndef freertos_h
+#define freertos_h
+
+// Headers like state.h include FreeRTOS without using it, nothing is needed on the host
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef task_h
+#define task_h
+
+#include "freertos/FreeRTOS.h"
+
+#endif
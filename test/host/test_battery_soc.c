@@ -0,0 +1,168 @@
+#include "check.h"
+#include "soc_estimator.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define RIDE_LOG_LOCATION "data/ride_log.csv"
+#define RIDE_LOG_MAX_RECORDS 8192
+#define BENCHMARK_ROUNDS 200
+
+#define PACK_CELLS 10
+#define PACK_CAPACITY_MAH 10000
+
+// The columns of LOG_RECORD_HEADER the estimator needs
+struct RideSample {
+  uint32_t time_ms;
+  float voltage;
+  float current;
+  float used_energy;
+  float state_of_charge;
+};
+
+static struct RideSample ride[RIDE_LOG_MAX_RECORDS];
+static uint32_t ride_count = 0;
+
+static void load_ride_log() {
+  char line[512];
+  unsigned int time_ms, timestamp;
+  double latitude, longitude;
+  float speed, voltage, current, used_energy, total_energy, trip_distance, altitude, state_of_charge;
+
+  FILE *f = fopen(RIDE_LOG_LOCATION, "r");
+  CHECK(f != NULL);
+  if (f == NULL) {
+    return;
+  }
+
+  while (fgets(line, sizeof(line), f) != NULL && ride_count < RIDE_LOG_MAX_RECORDS) {
+    if (sscanf(line, "%u,%u,%lf,%lf,%f,%f,%f,%f,%f,%f,%f,%f", &time_ms, &timestamp, &latitude, &longitude, &speed,
+               &voltage, &current, &used_energy, &total_energy, &trip_distance, &altitude, &state_of_charge) == 12) {
+      ride[ride_count++] = (struct RideSample){time_ms, voltage, current, used_energy, state_of_charge};
+    }
+  }
+  fclose(f);
+}
+
+static void test_ocv_lookup() {
+  struct SocEstimator estimator;
+  soc_estimator_init(&estimator, PACK_CELLS, PACK_CAPACITY_MAH);
+
+  int64_t per_mille = estimator.capacity_mas / 1000;
+  CHECK(soc_estimator_ocv_to_charge(&estimator, 30000) == 0);
+  CHECK(soc_estimator_ocv_to_charge(&estimator, 33000) == 0);
+  CHECK(soc_estimator_ocv_to_charge(&estimator, 37700) == 400 * per_mille);
+  CHECK(soc_estimator_ocv_to_charge(&estimator, 38250) == 550 * per_mille);
+  CHECK(soc_estimator_ocv_to_charge(&estimator, 42000) == estimator.capacity_mas);
+  CHECK(soc_estimator_ocv_to_charge(&estimator, 45000) == estimator.capacity_mas);
+}
+
+static void test_waits_for_voltage() {
+  struct SocEstimator estimator;
+  soc_estimator_init(&estimator, PACK_CELLS, PACK_CAPACITY_MAH);
+
+  soc_estimator_update(&estimator, 0, 5000, 0);
+  CHECK(!estimator.is_initialized);
+  soc_estimator_update(&estimator, 37700, 0, 1000);
+  CHECK(soc_estimator_get_permille(&estimator) == 400);
+  CHECK(soc_estimator_get_remaining_mah(&estimator) == 4000);
+}
+
+// Counts the whole discharge over the ride log, checked against the used energy the logger integrated
+static void test_ride_log() {
+  struct SocEstimator estimator;
+  soc_estimator_init(&estimator, PACK_CELLS, PACK_CAPACITY_MAH);
+
+  uint32_t ride_end = 0;
+  double max_soc_error = 0;
+  int64_t start_charge = 0;
+
+  for (uint32_t i = 0; i < ride_count; i++) {
+    soc_estimator_update(&estimator, lroundf(ride[i].voltage * 1000), lroundf(ride[i].current * 1000),
+                         (int64_t)ride[i].time_ms * 1000);
+    if (i == 0) {
+      start_charge = estimator.charge_mas;
+      continue;
+    }
+    if (fabsf(ride[i].current) > 1) {
+      ride_end = i;
+    }
+    max_soc_error = fmax(max_soc_error, fabs(soc_estimator_get_permille(&estimator) / 10.0 - ride[i].state_of_charge));
+  }
+  CHECK(ride_end > 0 && ride_end + 1 < ride_count);
+
+  double counted_mah = (start_charge - estimator.charge_mas) / (double)SOC_MAS_PER_MAH;
+  double logged_mah = ride[ride_count - 1].used_energy * 1000;
+  double final_error = soc_estimator_get_permille(&estimator) / 10.0 - ride[ride_count - 1].state_of_charge;
+
+  printf("%u records, counted %.0f mAh logged %.0f mAh, state of charge max error %.1f%% final %.1f%%\n",
+         ride_count, counted_mah, logged_mah, max_soc_error, final_error);
+  CHECK(fabs(counted_mah - logged_mah) < 0.02 * logged_mah);
+  CHECK(max_soc_error < 5);
+  CHECK(fabs(final_error) < 2);
+}
+
+// A counter started from a sagging voltage is wrong, resting for long enough pulls it back to the open circuit voltage
+static void test_rest_correction() {
+  struct SocEstimator estimator;
+  soc_estimator_init(&estimator, PACK_CELLS, PACK_CAPACITY_MAH);
+
+  soc_estimator_update(&estimator, 36900, 0, 0);
+  CHECK(soc_estimator_get_permille(&estimator) == 200);
+
+  int64_t time_us = 0;
+  for (uint16_t i = 0; i < 20; i++) {
+    time_us += 1000000;
+    soc_estimator_update(&estimator, 37700, 0, time_us);
+  }
+  CHECK(soc_estimator_get_permille(&estimator) == 200);
+
+  for (uint16_t i = 0; i < 200; i++) {
+    time_us += 1000000;
+    soc_estimator_update(&estimator, 37700, 0, time_us);
+  }
+  CHECK(abs(soc_estimator_get_permille(&estimator) - 400) <= 2);
+}
+
+static void test_clamp() {
+  struct SocEstimator estimator;
+  soc_estimator_init(&estimator, PACK_CELLS, PACK_CAPACITY_MAH);
+
+  soc_estimator_update(&estimator, 33500, 0, 0);
+  soc_estimator_update(&estimator, 33000, 20000, 3600LL * 1000000);
+  CHECK(estimator.charge_mas == 0);
+
+  soc_estimator_update(&estimator, 42000, -20000, 2 * 3600LL * 1000000);
+  CHECK(estimator.charge_mas == estimator.capacity_mas);
+}
+
+// Per update cost of the estimator, on the host this only hints at the cost on the ESP32
+static void benchmark() {
+  struct SocEstimator estimator;
+  volatile uint32_t sink = 0;
+
+  int64_t start = check_now_ns();
+  for (uint32_t round = 0; round < BENCHMARK_ROUNDS; round++) {
+    soc_estimator_init(&estimator, PACK_CELLS, PACK_CAPACITY_MAH);
+    for (uint32_t i = 0; i < ride_count; i++) {
+      soc_estimator_update(&estimator, ride[i].voltage * 1000, ride[i].current * 1000, (int64_t)ride[i].time_ms * 1000);
+      sink += soc_estimator_get_permille(&estimator);
+    }
+  }
+  int64_t elapsed_ns = check_now_ns() - start;
+
+  printf("per update: %.1f ns\n", (double)elapsed_ns / ((uint64_t)ride_count * BENCHMARK_ROUNDS));
+}
+
+int main() {
+  load_ride_log();
+  CHECK(ride_count > 0);
+
+  test_ocv_lookup();
+  test_waits_for_voltage();
+  test_ride_log();
+  test_rest_correction();
+  test_clamp();
+  benchmark();
+
+  CHECK_RESULT();
+}
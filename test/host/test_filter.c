@@ -0,0 +1,165 @@
+#include "check.h"
+#include "filter.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define TRACE_LOCATION "data/current_trace.log"
+#define TRACE_MAX_SAMPLES 4096
+#define BENCHMARK_ROUNDS 200
+
+#define MOVING_AVERAGE_SIZE 8
+#define LOW_PASS_SHIFT 2
+#define MEDIAN_SIZE 3
+
+// Current samples in mA, read from the A lines of a telemetry file
+static int32_t samples[TRACE_MAX_SAMPLES];
+static uint32_t sample_count = 0;
+
+static void load_trace() {
+  char line[128];
+  long long timestamp;
+  int current, voltage;
+
+  FILE *f = fopen(TRACE_LOCATION, "r");
+  CHECK(f != NULL);
+  if (f == NULL) {
+    return;
+  }
+
+  while (fgets(line, sizeof(line), f) != NULL && sample_count < TRACE_MAX_SAMPLES) {
+    if (sscanf(line, "A,%lld,%d,%d", &timestamp, &current, &voltage) == 3) {
+      samples[sample_count++] = current;
+    }
+  }
+  fclose(f);
+}
+
+static double reference_moving_average(uint32_t index) {
+  uint32_t first = index + 1 >= MOVING_AVERAGE_SIZE ? index + 1 - MOVING_AVERAGE_SIZE : 0;
+  double sum = 0;
+
+  for (uint32_t i = first; i <= index; i++) {
+    sum += samples[i];
+  }
+  return sum / (index - first + 1);
+}
+
+static double reference_median(uint32_t index) {
+  uint32_t first = index + 1 >= MEDIAN_SIZE ? index + 1 - MEDIAN_SIZE : 0;
+  double window[MEDIAN_SIZE];
+  uint8_t count = 0;
+
+  for (uint32_t i = first; i <= index; i++) {
+    double value = samples[i];
+    int8_t j = count - 1;
+    while (j >= 0 && window[j] > value) {
+      window[j + 1] = window[j];
+      j--;
+    }
+    window[j + 1] = value;
+    count++;
+  }
+  return window[count / 2];
+}
+
+// Integer division and the 8 fractional bits of the low-pass state round, the results may differ by a count or two
+static void test_against_reference() {
+  struct MovingAverageFilter moving_average;
+  struct LowPassFilter low_pass;
+  struct MedianFilter median;
+  double reference_low_pass = 0;
+  double max_error[3] = {0, 0, 0};
+
+  filter_moving_average_init(&moving_average, MOVING_AVERAGE_SIZE);
+  filter_low_pass_init(&low_pass, LOW_PASS_SHIFT);
+  filter_median_init(&median, MEDIAN_SIZE);
+
+  for (uint32_t i = 0; i < sample_count; i++) {
+    if (i == 0) {
+      reference_low_pass = samples[0];
+    } else {
+      reference_low_pass += (samples[i] - reference_low_pass) / (1 << LOW_PASS_SHIFT);
+    }
+
+    max_error[0] = fmax(max_error[0], fabs(filter_moving_average_update(&moving_average, samples[i]) -
+                                           reference_moving_average(i)));
+    max_error[1] = fmax(max_error[1], fabs(filter_low_pass_update(&low_pass, samples[i]) - reference_low_pass));
+    max_error[2] = fmax(max_error[2], fabs(filter_median_update(&median, samples[i]) - reference_median(i)));
+  }
+
+  printf("%u samples, max error moving average %.2f mA low-pass %.2f mA median %.2f mA\n", sample_count,
+         max_error[0], max_error[1], max_error[2]);
+  CHECK(max_error[0] < 1.0);
+  CHECK(max_error[1] < 2.0);
+  CHECK(max_error[2] == 0);
+}
+
+static void test_zero_size() {
+  struct MovingAverageFilter moving_average;
+  struct MedianFilter median;
+
+  filter_moving_average_init(&moving_average, 0);
+  filter_median_init(&median, 0);
+
+  CHECK(filter_moving_average_update(&moving_average, -5) == -5);
+  CHECK(filter_median_update(&median, 7) == 7);
+}
+
+static void test_negative_low_pass() {
+  struct LowPassFilter low_pass;
+
+  filter_low_pass_init(&low_pass, LOW_PASS_SHIFT);
+  CHECK(filter_low_pass_update(&low_pass, -3000) == -3000);
+  for (uint8_t i = 0; i < 64; i++) {
+    filter_low_pass_update(&low_pass, -1000);
+  }
+  CHECK(abs(filter_low_pass_update(&low_pass, -1000) + 1000) <= 1);
+}
+
+// Fixed point against the same filters in double, per sample cost on the host only hints at the ratio on the ESP32
+static void benchmark() {
+  struct MovingAverageFilter moving_average;
+  struct LowPassFilter low_pass;
+  struct MedianFilter median;
+  volatile int64_t sink = 0;
+  volatile double double_sink = 0;
+
+  filter_moving_average_init(&moving_average, MOVING_AVERAGE_SIZE);
+  filter_low_pass_init(&low_pass, LOW_PASS_SHIFT);
+  filter_median_init(&median, MEDIAN_SIZE);
+
+  int64_t start = check_now_ns();
+  for (uint32_t round = 0; round < BENCHMARK_ROUNDS; round++) {
+    for (uint32_t i = 0; i < sample_count; i++) {
+      int32_t sample = filter_median_update(&median, samples[i]);
+      sink += filter_low_pass_update(&low_pass, sample) + filter_moving_average_update(&moving_average, sample);
+    }
+  }
+  int64_t fixed_ns = check_now_ns() - start;
+
+  double low_pass_state = samples[0];
+  start = check_now_ns();
+  for (uint32_t round = 0; round < BENCHMARK_ROUNDS; round++) {
+    for (uint32_t i = 0; i < sample_count; i++) {
+      double sample = reference_median(i);
+      low_pass_state += (sample - low_pass_state) / (1 << LOW_PASS_SHIFT);
+      double_sink += low_pass_state + reference_moving_average(i);
+    }
+  }
+  int64_t double_ns = check_now_ns() - start;
+
+  uint64_t total = (uint64_t)sample_count * BENCHMARK_ROUNDS;
+  printf("per sample: fixed point %.1f ns, double %.1f ns\n", (double)fixed_ns / total, (double)double_ns / total);
+}
+
+int main() {
+  load_trace();
+  CHECK(sample_count > 0);
+
+  test_against_reference();
+  test_zero_size();
+  test_negative_low_pass();
+  benchmark();
+
+  CHECK_RESULT();
+}
@@ -0,0 +1,207 @@
+#include "check.h"
+#include "kalman.h"
+#include "nmea.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define TRACE_LOCATION "data/nmea_trace.log"
+#define TRACE_MAX_SENTENCES 8192
+#define SENTENCE_MAX 128
+#define BENCHMARK_ROUNDS 50
+
+#define d2r (M_PI / 180.0)
+#define EARTH_RADIUS_M 6367000.0
+
+// gps_rx_task publishes an estimate this often between fixes
+#define ESTIMATE_INTERVAL_US 200000
+#define MOVING_SPEED_KMH 5.0
+// the filter restarts with zero velocity after the fix timeout, the first fixes after that are not compared
+#define SETTLE_FIXES 10
+#define RESTART_TIMEOUT_US 5000000
+
+// Complete sentences as gps_rx_task hands them over, '\r' still attached
+static char sentences[TRACE_MAX_SENTENCES][SENTENCE_MAX];
+static uint32_t sentence_count = 0;
+
+static void load_trace() {
+  FILE *f = fopen(TRACE_LOCATION, "r");
+  CHECK(f != NULL);
+  if (f == NULL) {
+    return;
+  }
+
+  while (sentence_count < TRACE_MAX_SENTENCES && fgets(sentences[sentence_count], SENTENCE_MAX, f) != NULL) {
+    sentences[sentence_count][strcspn(sentences[sentence_count], "\n")] = 0;
+    sentence_count++;
+  }
+  fclose(f);
+}
+
+// hhmmss.ss of a GGA sentence, each epoch of the trace starts with one
+static int64_t sentence_time_us(const char *sentence) {
+  char field[16];
+
+  if (!nmea_get_field(sentence, 1, field, sizeof(field))) {
+    return -1;
+  }
+  double value = atof(field);
+  int hours = (int)(value / 10000);
+  int minutes = (int)(value / 100) % 100;
+  return (int64_t)((hours * 3600 + minutes * 60 + (value - hours * 10000 - minutes * 100)) * 1000000);
+}
+
+static double distance_m(double lat1, double long1, double lat2, double long2) {
+  double x = (long2 - long1) * d2r * cos((lat1 + lat2) * 0.5 * d2r);
+  double y = (lat2 - lat1) * d2r;
+  return EARTH_RADIUS_M * sqrt(x * x + y * y);
+}
+
+static void test_parsers() {
+  double latitude, longitude, speed, course = -1, altitude;
+  uint8_t fix, satelite_number;
+
+  CHECK(nmea_is_checksum_valid("$GNGLL,5213.78266,N,02100.73208,E,100000.00,A,A*73\r"));
+  CHECK(!nmea_is_checksum_valid("$GNGLL,5213.78266,N,02100.73208,E,100000.00,A,A*74\r"));
+  CHECK(!nmea_is_checksum_valid("$GNGLL,5213.78266,N,02100.73208,E,100000.00,A,A*7"));
+  CHECK(!nmea_is_checksum_valid("GNGLL,5213.78266,N*73"));
+
+  CHECK(nmea_get_location("$GNGLL,5213.78266,N,02100.73208,E,100000.00,A,A*73\r", &latitude, &longitude));
+  CHECK(fabs(latitude - (52 + 13.78266 / 60)) < 1e-9);
+  CHECK(fabs(longitude - (21 + 0.73208 / 60)) < 1e-9);
+  CHECK(nmea_get_location("$GNGLL,3351.12000,S,15112.60000,W,100000.00,A,A*00", &latitude, &longitude));
+  CHECK(latitude < -33.8 && longitude < -151.2);
+  CHECK(!nmea_get_location("$GNGLL,,,,,100000.00,V,N*00", &latitude, &longitude));
+
+  CHECK(nmea_get_speed("$GNVTG,,T,,M,0.064,N,0.119,K,A*36", &speed, &course));
+  CHECK(fabs(speed - 0.119) < 1e-9 && course == -1);
+  CHECK(nmea_get_speed("$GNVTG,123.40,T,,M,10.000,N,18.520,K,A*00", &speed, &course));
+  CHECK(fabs(speed - 18.52) < 1e-9 && fabs(course - 123.4) < 1e-9);
+  CHECK(!nmea_get_speed("$GNVTG,,T,,M,,N,,K,N*00", &speed, &course));
+
+  satelite_number = 0;
+  altitude = 0;
+  CHECK(nmea_get_satelite_info("$GNGGA,100000.00,,,,,0,03,25.0,,M,,M,,*00", &fix, &satelite_number, &altitude));
+  CHECK(fix == 0 && satelite_number == 3 && altitude == 0);
+  CHECK(nmea_get_satelite_info("$GNGGA,100000.00,5213.78266,N,02100.73208,E,1,09,0.9,110.5,M,34.5,M,,*71", &fix,
+                               &satelite_number, &altitude));
+  CHECK(fix == 1 && satelite_number == 9 && fabs(altitude - 110.5) < 1e-9);
+}
+
+// Replays the trace the way gps_rx_task does and compares the estimates with the fixes and VTG speeds they came from
+static void test_trace() {
+  struct KalmanEstimate estimate;
+  double latitude = 0, longitude = 0, speed = 0, course = 0;
+  double max_position_error = 0, max_speed_error = 0, sum_position_error = 0;
+  uint32_t valid = 0, fixes = 0, compared = 0, estimates_after_timeout = 0, settled_fixes = 0;
+  int64_t now = 0, last_fix_time = -1;
+  bool is_lost_reported = false;
+
+  kalman_reset();
+  for (uint32_t i = 0; i < sentence_count; i++) {
+    const char *sentence = sentences[i];
+    if (!nmea_is_checksum_valid(sentence)) {
+      continue;
+    }
+    valid++;
+
+    if (strncmp(sentence, "$GNGGA", 6) == 0) {
+      int64_t epoch = sentence_time_us(sentence);
+      // estimates published between the previous epoch and this one
+      for (int64_t time = now + ESTIMATE_INTERVAL_US; last_fix_time >= 0 && time < epoch;
+           time += ESTIMATE_INTERVAL_US) {
+        bool has_estimate = kalman_get_estimate(time, &estimate);
+        if (time - last_fix_time > RESTART_TIMEOUT_US) {
+          estimates_after_timeout += has_estimate;
+          is_lost_reported |= !has_estimate;
+        }
+      }
+      now = epoch;
+    } else if (strncmp(sentence, "$GNVTG", 6) == 0) {
+      if (nmea_get_speed(sentence, &speed, &course)) {
+        kalman_update_velocity(speed, course, now);
+      }
+    } else if (strncmp(sentence, "$GNGLL", 6) == 0 && nmea_get_location(sentence, &latitude, &longitude)) {
+      if (last_fix_time < 0 || now - last_fix_time > RESTART_TIMEOUT_US) {
+        settled_fixes = 0;
+      }
+      kalman_update_position(latitude, longitude, now);
+      last_fix_time = now;
+      fixes++;
+      settled_fixes++;
+
+      CHECK(kalman_get_estimate(now, &estimate));
+      if (settled_fixes > SETTLE_FIXES && speed > MOVING_SPEED_KMH) {
+        double error = distance_m(latitude, longitude, estimate.latitude, estimate.longitude);
+        max_position_error = fmax(max_position_error, error);
+        max_speed_error = fmax(max_speed_error, fabs(estimate.speed - speed));
+        sum_position_error += error;
+        compared++;
+      }
+    }
+  }
+
+  printf("%u sentences, %u valid, %u fixes, estimate to fix mean %.1f m max %.1f m, speed max %.1f km/h\n",
+         sentence_count, valid, fixes, sum_position_error / compared, max_position_error, max_speed_error);
+  CHECK(valid < sentence_count);
+  CHECK(fixes > 800);
+  CHECK(compared > 0);
+  CHECK(max_position_error < 15);
+  CHECK(max_speed_error < 5);
+  CHECK(is_lost_reported);
+  CHECK(estimates_after_timeout == 0);
+}
+
+// Per sentence parse and per call filter cost over the trace, on the host this only hints at the cost on the ESP32
+static void benchmark() {
+  struct KalmanEstimate estimate;
+  double latitude, longitude, speed, course, altitude;
+  uint8_t fix, satelite_number;
+  volatile double sink = 0;
+  uint32_t updates = 0;
+
+  int64_t start = check_now_ns();
+  for (uint32_t round = 0; round < BENCHMARK_ROUNDS; round++) {
+    for (uint32_t i = 0; i < sentence_count; i++) {
+      const char *sentence = sentences[i];
+      if (!nmea_is_checksum_valid(sentence)) {
+        continue;
+      }
+      if (strncmp(sentence, "$GNGLL", 6) == 0 && nmea_get_location(sentence, &latitude, &longitude)) {
+        sink += latitude + longitude;
+      } else if (strncmp(sentence, "$GNVTG", 6) == 0 && nmea_get_speed(sentence, &speed, &course)) {
+        sink += speed;
+      } else if (strncmp(sentence, "$GNGGA", 6) == 0 &&
+                 nmea_get_satelite_info(sentence, &fix, &satelite_number, &altitude)) {
+        sink += fix;
+      }
+    }
+  }
+  int64_t parse_ns = check_now_ns() - start;
+
+  start = check_now_ns();
+  for (uint32_t round = 0; round < BENCHMARK_ROUNDS; round++) {
+    kalman_reset();
+    for (int64_t time = 0; time < (int64_t)sentence_count * 1000000 / 3; time += 1000000) {
+      kalman_update_velocity(20, 45, time);
+      kalman_update_position(52.0 + time * 1e-11, 21.0 + time * 1e-11, time);
+      kalman_get_estimate(time + ESTIMATE_INTERVAL_US, &estimate);
+      sink += estimate.latitude;
+      updates++;
+    }
+  }
+  int64_t kalman_ns = check_now_ns() - start;
+
+  printf("per sentence: parse %.1f ns, per fix: kalman update and estimate %.1f ns\n",
+         (double)parse_ns / ((uint64_t)sentence_count * BENCHMARK_ROUNDS), (double)kalman_ns / updates);
+}
+
+int main() {
+  load_trace();
+  CHECK(sentence_count > 0);
+
+  test_parsers();
+  test_trace();
+  benchmark();
+
+  CHECK_RESULT();
+}
@@ -0,0 +1,40 @@
+#include "check.h"
+#include "http_range.h"
+
+static void check_range(const char *header, size_t size, size_t expected_first, size_t expected_last) {
+  size_t first = 0;
+  size_t last = 0;
+
+  if (!http_parse_range(header, size, &first, &last) || first != expected_first || last != expected_last) {
+    printf("%s size %zu: expected %zu-%zu got %zu-%zu\n", header, size, expected_first, expected_last, first, last);
+    check_failures++;
+  }
+}
+
+static void check_unsatisfiable(const char *header, size_t size) {
+  size_t first = 0;
+  size_t last = 0;
+
+  if (http_parse_range(header, size, &first, &last)) {
+    printf("%s size %zu: expected unsatisfiable got %zu-%zu\n", header, size, first, last);
+    check_failures++;
+  }
+}
+
+int main() {
+  check_range("bytes=0-99", 1000, 0, 99);
+  check_range("bytes=100-", 1000, 100, 999);
+  check_range("bytes=900-5000", 1000, 900, 999);
+  check_range("bytes=999-999", 1000, 999, 999);
+  check_range("bytes=-100", 1000, 900, 999);
+  check_range("bytes=-5000", 1000, 0, 999);
+
+  check_unsatisfiable("bytes=1000-", 1000);
+  check_unsatisfiable("bytes=500-100", 1000);
+  check_unsatisfiable("bytes=-0", 1000);
+  check_unsatisfiable("bytes=0-10", 0);
+  check_unsatisfiable("bytes=abc", 1000);
+  check_unsatisfiable("items=0-10", 1000);
+
+  CHECK_RESULT();
+}
@@ -0,0 +1,124 @@
+#include "check.h"
+#include "json_writer.h"
+#include <math.h>
+
+struct Output {
+  char data[2048];
+  size_t length;
+  uint8_t flushes;
+  bool fail;
+};
+
+static bool test_flush(const char *data, size_t length, void *context) {
+  struct Output *output = context;
+
+  if (output->fail || output->length + length >= sizeof(output->data)) {
+    return false;
+  }
+  memcpy(output->data + output->length, data, length);
+  output->length += length;
+  output->data[output->length] = 0;
+  output->flushes++;
+  return true;
+}
+
+static void test_nesting(struct JsonWriter *writer, struct Output *output) {
+  memset(output, 0, sizeof(*output));
+  json_writer_init(writer, test_flush, output);
+
+  json_begin_object(writer, NULL);
+  json_int(writer, "id", -42);
+  json_bool(writer, "ok", true);
+  json_begin_array(writer, "items");
+  json_int(writer, NULL, 1);
+  json_begin_object(writer, NULL);
+  json_end_object(writer);
+  json_int(writer, NULL, 2);
+  json_end_array(writer);
+  json_begin_object(writer, "empty");
+  json_end_object(writer);
+  json_bool(writer, "last", false);
+  json_end_object(writer);
+
+  CHECK(json_writer_finish(writer));
+  CHECK_STRING(output->data, "{\"id\":-42,\"ok\":true,\"items\":[1,{},2],\"empty\":{},\"last\":false}");
+}
+
+static void test_numbers(struct JsonWriter *writer, struct Output *output) {
+  memset(output, 0, sizeof(*output));
+  json_writer_init(writer, test_flush, output);
+
+  json_begin_array(writer, NULL);
+  json_double(writer, NULL, 3.14159, 2);
+  json_double(writer, NULL, -0.5, 1);
+  json_double(writer, NULL, NAN, 2);
+  json_double(writer, NULL, INFINITY, 2);
+  json_int(writer, NULL, 4294967296LL);
+  json_end_array(writer);
+
+  CHECK(json_writer_finish(writer));
+  CHECK_STRING(output->data, "[3.14,-0.5,null,null,4294967296]");
+}
+
+static void test_strings(struct JsonWriter *writer, struct Output *output) {
+  memset(output, 0, sizeof(*output));
+  json_writer_init(writer, test_flush, output);
+
+  json_begin_object(writer, NULL);
+  json_string(writer, "quote", "a\"b\\c", 16);
+  json_string(writer, "control", "line\nend\x01", 16);
+  json_string(writer, "limited", "abcdef", 3);
+  json_string(writer, "k\"ey", "", 4);
+  json_end_object(writer);
+
+  CHECK(json_writer_finish(writer));
+  CHECK_STRING(output->data, "{\"quote\":\"a\\\"b\\\\c\",\"control\":\"line\\u000aend\\u0001\","
+                             "\"limited\":\"abc\",\"k\\\"ey\":\"\"}");
+}
+
+// Output longer than the buffer goes out in several flushes without losing or reordering anything
+static void test_flushes(struct JsonWriter *writer, struct Output *output) {
+  char expected[2048];
+  size_t length = 1;
+
+  memset(output, 0, sizeof(*output));
+  json_writer_init(writer, test_flush, output);
+
+  expected[0] = '[';
+  json_begin_array(writer, NULL);
+  for (int i = 0; i < 200; i++) {
+    json_int(writer, NULL, i);
+    length += snprintf(expected + length, sizeof(expected) - length, i == 0 ? "%d" : ",%d", i);
+  }
+  json_end_array(writer);
+  snprintf(expected + length, sizeof(expected) - length, "]");
+
+  CHECK(json_writer_finish(writer));
+  CHECK(output->flushes > 1);
+  CHECK_STRING(output->data, expected);
+}
+
+static void test_failed_flush(struct JsonWriter *writer, struct Output *output) {
+  memset(output, 0, sizeof(*output));
+  output->fail = true;
+  json_writer_init(writer, test_flush, output);
+
+  json_begin_object(writer, NULL);
+  json_end_object(writer);
+
+  CHECK(!json_writer_finish(writer));
+  CHECK(output->length == 0);
+}
+
+int main() {
+  static struct JsonWriter writer;
+  static struct Output output;
+
+  test_nesting(&writer, &output);
+  test_numbers(&writer, &output);
+  test_strings(&writer, &output);
+  test_flushes(&writer, &output);
+  test_failed_flush(&writer, &output);
+
+  CHECK_RESULT();
+}
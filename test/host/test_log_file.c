@@ -0,0 +1,139 @@
+#include "check.h"
+#include "esp_timer.h"
+#include "log_file.h"
+#include "storage_space.h"
+
+#define RIDE_SECONDS (2 * 3600)
+#define RIDE_LINE_SIZE 120
+#define VOLUME_SEED 35
+
+// Free space tracker double, log_file reports every cluster it takes or gives back
+static int32_t allocated_clusters = 0;
+
+uint32_t storage_space_clusters(uint64_t bytes) { return (bytes + FF_SHIM_CLUSTER_SIZE - 1) / FF_SHIM_CLUSTER_SIZE; }
+
+void storage_space_allocate(int32_t clusters) { allocated_clusters += clusters; }
+
+struct RideResult {
+  bool is_contiguous;
+  bool is_written;
+  uint32_t fat_writes;
+  uint32_t p50_us;
+  uint32_t p99_us;
+  uint32_t max_us;
+};
+
+// Two hours of one line per second, as the logger writes a ride
+static struct RideResult ride(uint32_t preallocate_size) {
+  struct LogFile log_file;
+  struct RideResult result = {.is_written = true};
+  char line[RIDE_LINE_SIZE];
+
+  memset(line, 'x', sizeof(line));
+  allocated_clusters = 0;
+  uint32_t free_clusters = ff_shim_get_free_clusters();
+
+  CHECK(log_file_open(&log_file, "/sdcard/logs/ride.csv", preallocate_size));
+  result.is_contiguous = log_file.is_contiguous;
+  uint32_t fat_writes = ff_shim_get_fat_writes();
+
+  for (uint32_t second = 0; second < RIDE_SECONDS; second++) {
+    result.is_written &= log_file_write(&log_file, line, sizeof(line));
+    esp_timer_shim_advance(1000000);
+  }
+  result.fat_writes = ff_shim_get_fat_writes() - fat_writes;
+  result.p50_us = log_file_latency_percentile_us(&log_file, 50);
+  result.p99_us = log_file_latency_percentile_us(&log_file, 99);
+  result.max_us = log_file.max_latency_us;
+  log_file_close(&log_file);
+
+  uint32_t used_clusters = storage_space_clusters((uint64_t)RIDE_SECONDS * RIDE_LINE_SIZE);
+  CHECK(f_size(&log_file.file) == RIDE_SECONDS * RIDE_LINE_SIZE);
+  CHECK(allocated_clusters == used_clusters);
+  CHECK(ff_shim_get_free_clusters() == free_clusters - used_clusters);
+  return result;
+}
+
+// Same fragmented card for both, the preallocated run never touches the FAT while riding
+static void test_preallocated_against_on_demand() {
+  ff_shim_format(30, 32, VOLUME_SEED);
+  struct RideResult preallocated = ride(LOG_FILE_PREALLOCATE_SIZE);
+  ff_shim_format(30, 32, VOLUME_SEED);
+  struct RideResult on_demand = ride(0);
+
+  printf("simulated write latency, preallocated p50 < %u us p99 < %u us max %u us, FAT sector writes %u\n",
+         preallocated.p50_us, preallocated.p99_us, preallocated.max_us, preallocated.fat_writes);
+  printf("simulated write latency, on demand p50 < %u us p99 < %u us max %u us, FAT sector writes %u\n",
+         on_demand.p50_us, on_demand.p99_us, on_demand.max_us, on_demand.fat_writes);
+
+  CHECK(preallocated.is_contiguous && preallocated.is_written);
+  CHECK(!on_demand.is_contiguous && on_demand.is_written);
+  CHECK(preallocated.fat_writes == 0);
+  CHECK(on_demand.fat_writes > 0);
+  CHECK(preallocated.max_us < on_demand.max_us);
+  CHECK(preallocated.p99_us <= on_demand.p99_us);
+}
+
+// Clusters scattered one by one leave no run for f_expand, the file still grows on demand
+static void test_fallback() {
+  ff_shim_format(50, 1, VOLUME_SEED);
+  struct RideResult fallback = ride(LOG_FILE_PREALLOCATE_SIZE);
+
+  CHECK(!fallback.is_contiguous && fallback.is_written);
+  CHECK(fallback.fat_writes > 0);
+}
+
+// Running out of clusters mid-write leaves the file at the last whole write, and nothing is appended after it
+static void test_failed_write() {
+  struct LogFile log_file;
+  char data[1000];
+
+  memset(data, 'x', sizeof(data));
+  ff_shim_limit_free_clusters(1);
+  allocated_clusters = 0;
+
+  CHECK(log_file_open(&log_file, "/sdcard/logs/full.csv", 0));
+  for (uint8_t i = 0; i < FF_SHIM_CLUSTER_SIZE / sizeof(data); i++) {
+    CHECK(log_file_write(&log_file, data, sizeof(data)));
+  }
+  FSIZE_t written = f_tell(&log_file.file);
+
+  CHECK(!log_file_write(&log_file, data, sizeof(data)));
+  CHECK(f_tell(&log_file.file) == written);
+  log_file_close(&log_file);
+
+  CHECK(f_size(&log_file.file) == written);
+  CHECK(allocated_clusters == 1);
+  CHECK(!log_file_reopen(&log_file, "/sdcard/logs/full.csv") && !log_file.is_open);
+}
+
+static void test_percentiles() {
+  struct LogFile log_file = {.writes = 100, .max_latency_us = 5000000};
+
+  log_file.latency_histogram[0] = 90;
+  log_file.latency_histogram[3] = 9;
+  log_file.latency_histogram[LOG_FILE_LATENCY_BUCKETS - 1] = 1;
+
+  CHECK(log_file_latency_percentile_us(&log_file, 50) == 1000);
+  CHECK(log_file_latency_percentile_us(&log_file, 90) == 1000);
+  CHECK(log_file_latency_percentile_us(&log_file, 91) == 8000);
+  CHECK(log_file_latency_percentile_us(&log_file, 99) == 8000);
+  CHECK(log_file_latency_percentile_us(&log_file, 100) == 5000000);
+}
+
+static void test_closed() {
+  struct LogFile log_file = {.is_open = false};
+
+  CHECK(!log_file_write(&log_file, "x", 1));
+  log_file_close(&log_file);
+}
+
+int main() {
+  test_preallocated_against_on_demand();
+  test_fallback();
+  test_failed_write();
+  test_percentiles();
+  test_closed();
+
+  CHECK_RESULT();
+}
@@ -0,0 +1,134 @@
+#include "check.h"
+#include "odometer.h"
+#include <math.h>
+
+#define BENCHMARK_CALLS 1000000
+
+#define d2r (M_PI / 180.0)
+#define EARTH_RADIUS_KM 6367.0
+
+#define ROUTE_SECONDS 1800
+#define ROUTE_SPEED_KMH 20.0
+#define ROUTE_JITTER_KM 0.002
+
+// Deterministic noise in [-1, 1) so the route is the same on every run
+static uint32_t noise_state = 30;
+
+static double noise() {
+  noise_state = noise_state * 1664525 + 1013904223;
+  return (noise_state >> 8) / (double)(1 << 23) - 1.0;
+}
+
+// Point distance_km away on a great circle at the given bearing, in double as the reference
+static void destination(double latitude, double longitude, double bearing, double distance_km, double *to_latitude,
+                        double *to_longitude) {
+  double angle = distance_km / EARTH_RADIUS_KM;
+  double lat1 = latitude * d2r;
+  double lat2 = asin(sin(lat1) * cos(angle) + cos(lat1) * sin(angle) * cos(bearing * d2r));
+  double dlong = atan2(sin(bearing * d2r) * sin(angle) * cos(lat1), cos(angle) - sin(lat1) * sin(lat2));
+
+  *to_latitude = lat2 / d2r;
+  *to_longitude = longitude + dlong / d2r;
+}
+
+// The float equirectangular approximation against haversine over segment lengths the odometer sees
+static void test_accuracy() {
+  const double latitudes[] = {0, 45, 52, 65, 75};
+  const double lengths_km[] = {0.003, 0.01, 0.1, 1, 10};
+  double max_error = 0;
+
+  for (uint8_t i = 0; i < sizeof(latitudes) / sizeof(latitudes[0]); i++) {
+    for (uint8_t j = 0; j < sizeof(lengths_km) / sizeof(lengths_km[0]); j++) {
+      for (double bearing = 0; bearing < 360; bearing += 30) {
+        double latitude, longitude;
+        destination(latitudes[i], 21.0, bearing, lengths_km[j], &latitude, &longitude);
+
+        double exact = haversine_km(latitudes[i], 21.0, latitude, longitude);
+        double approximate = distance_equirectangular_km(latitudes[i], 21.0, latitude, longitude);
+        max_error = fmax(max_error, fabs(approximate - exact) / exact);
+        CHECK(fabs(exact - lengths_km[j]) < 1e-6 * lengths_km[j] + 1e-9);
+      }
+    }
+  }
+
+  printf("equirectangular max relative error %.2e\n", max_error);
+  CHECK(max_error < 1e-3);
+}
+
+// A ride with jittered fixes, stops and one gap after losing fix, against the exact length of the route
+static void test_route() {
+  struct Odometer odometer;
+  double latitude = 52.2297, longitude = 21.0122, bearing = 0;
+  double route_km = 0, counted_km = 0, stopped_km = 0;
+
+  odometer_reset(&odometer);
+  odometer_add_fix(&odometer, latitude, longitude, 0);
+
+  for (uint32_t second = 1; second <= ROUTE_SECONDS; second++) {
+    bool is_stopped = second % 300 >= 270;
+    double speed = is_stopped ? 0 : ROUTE_SPEED_KMH + 4 * noise();
+
+    if (second == ROUTE_SECONDS / 2) {
+      // fix lost and regained 15 km further
+      destination(latitude, longitude, bearing, 15, &latitude, &longitude);
+      route_km += 15;
+    } else if (!is_stopped) {
+      bearing = fmod(bearing + 3 * noise() + 360, 360);
+      destination(latitude, longitude, bearing, speed / 3600, &latitude, &longitude);
+      route_km += speed / 3600;
+    }
+
+    double fix_latitude, fix_longitude;
+    destination(latitude, longitude, 180 * (noise() + 1), ROUTE_JITTER_KM * fabs(noise()), &fix_latitude,
+                &fix_longitude);
+
+    double chunk = odometer_add_fix(&odometer, fix_latitude, fix_longitude, speed);
+    counted_km += chunk;
+    if (is_stopped) {
+      stopped_km += chunk;
+    }
+  }
+
+  printf("route %.3f km, counted %.3f km (%+.2f%%)\n", route_km, counted_km, (counted_km - route_km) / route_km * 100);
+  CHECK(stopped_km == 0);
+  CHECK(fabs(counted_km - route_km) < 0.02 * route_km);
+}
+
+static void test_first_fix() {
+  struct Odometer odometer;
+
+  odometer_reset(&odometer);
+  CHECK(odometer_add_fix(&odometer, 52.0, 21.0, 30) == 0);
+  CHECK(odometer_add_fix(&odometer, 52.00001, 21.0, 30) == 0);
+  CHECK(odometer_add_fix(&odometer, 52.001, 21.0, 30) > 0.1);
+}
+
+// Per call cost of both formulas, on the host this only hints at the ratio on the ESP32 without a double FPU
+static void benchmark() {
+  volatile double sink = 0;
+  double latitude = 52.2297, longitude = 21.0122;
+
+  int64_t start = check_now_ns();
+  for (uint32_t i = 0; i < BENCHMARK_CALLS; i++) {
+    sink += distance_equirectangular_km(latitude, longitude, latitude + i * 1e-9, longitude + 1e-4);
+  }
+  int64_t equirectangular_ns = check_now_ns() - start;
+
+  start = check_now_ns();
+  for (uint32_t i = 0; i < BENCHMARK_CALLS; i++) {
+    sink += haversine_km(latitude, longitude, latitude + i * 1e-9, longitude + 1e-4);
+  }
+  int64_t haversine_ns = check_now_ns() - start;
+
+  printf("per call: equirectangular %.1f ns, haversine %.1f ns\n", (double)equirectangular_ns / BENCHMARK_CALLS,
+         (double)haversine_ns / BENCHMARK_CALLS);
+}
+
+int main() {
+  test_accuracy();
+  test_route();
+  test_first_fix();
+  benchmark();
+
+  CHECK_RESULT();
+}
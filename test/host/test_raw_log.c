@@ -0,0 +1,169 @@
+#include "check.h"
+#include "esp_partition.h"
+#include "raw_log.h"
+
+#define RECORDS_PER_SECTOR ((RAW_LOG_SECTOR_SIZE - sizeof(struct RawLogSectorHeader)) / sizeof(struct TestRecord))
+#define READ_MAX_RECORDS 1024
+
+struct TestRecord {
+  uint32_t session;
+  uint32_t index;
+  uint8_t fill[52];
+};
+
+// Records handed out by raw_log_read_session, checked to come back in the order they were appended
+struct ReadResult {
+  uint32_t count;
+  uint32_t first_index;
+  bool is_ordered;
+  bool is_intact;
+};
+
+static void read_record(const void *data, void *context) {
+  const struct TestRecord *record = data;
+  struct ReadResult *result = context;
+
+  if (result->count == 0) {
+    result->first_index = record->index;
+  } else if (record->index != result->first_index + result->count) {
+    result->is_ordered = false;
+  }
+  for (uint8_t i = 0; i < sizeof(record->fill); i++) {
+    if (record->fill[i] != (uint8_t)(record->index + i)) {
+      result->is_intact = false;
+    }
+  }
+  result->count++;
+}
+
+static struct ReadResult read_session(uint32_t session) {
+  struct ReadResult result = {.is_ordered = true, .is_intact = true};
+
+  CHECK(raw_log_read_session(session, read_record, &result) == result.count);
+  return result;
+}
+
+static void append_records(uint32_t session, uint32_t first_index, uint32_t count) {
+  struct TestRecord record = {.session = session};
+
+  for (uint32_t i = 0; i < count; i++) {
+    record.index = first_index + i;
+    for (uint8_t j = 0; j < sizeof(record.fill); j++) {
+      record.fill[j] = record.index + j;
+    }
+    CHECK(raw_log_append(&record));
+  }
+}
+
+static void write_session(uint32_t session, uint32_t count) {
+  raw_log_begin(session, sizeof(struct TestRecord));
+  append_records(session, 0, count);
+  raw_log_end();
+}
+
+#define CHECK_SESSION(session, expected_count, expected_first_index)                                                   \
+  do {                                                                                                                 \
+    struct ReadResult result = read_session(session);                                                                  \
+    CHECK(result.count == (expected_count));                                                                           \
+    CHECK(result.count == 0 || result.first_index == (expected_first_index));                                          \
+    CHECK(result.is_ordered && result.is_intact);                                                                      \
+  } while (0)
+
+static void start(bool erase) {
+  if (erase) {
+    flash_shim_reset();
+  }
+  CHECK(raw_log_init());
+}
+
+static void test_sessions() {
+  start(true);
+  write_session(1, RECORDS_PER_SECTOR * 2 + 16);
+  write_session(2, 10);
+
+  CHECK_SESSION(1, RECORDS_PER_SECTOR * 2 + 16, 0);
+  CHECK_SESSION(2, 10, 0);
+  CHECK_SESSION(3, 0, 0);
+  CHECK(flash_shim_get_program_errors() == 0);
+}
+
+// Five sectors of sessions on a four sector ring, the oldest sector is reused and the ring order survives a reboot
+static void test_wraparound() {
+  start(true);
+  write_session(1, RECORDS_PER_SECTOR * 3);
+  write_session(2, RECORDS_PER_SECTOR * 2);
+
+  CHECK_SESSION(1, RECORDS_PER_SECTOR * 2, RECORDS_PER_SECTOR);
+  CHECK_SESSION(2, RECORDS_PER_SECTOR * 2, 0);
+
+  start(false);
+  write_session(3, 10);
+
+  CHECK_SESSION(1, RECORDS_PER_SECTOR, RECORDS_PER_SECTOR * 2);
+  CHECK_SESSION(2, RECORDS_PER_SECTOR * 2, 0);
+  CHECK_SESSION(3, 10, 0);
+  CHECK(flash_shim_get_program_errors() == 0);
+}
+
+// Power lost after part of length and crc were programmed, every record of the sector is still read back and the
+// next session starts on a fresh sector
+static void test_torn_seal() {
+  for (int32_t budget = 0; budget < 6; budget++) {
+    start(true);
+    raw_log_begin(1, sizeof(struct TestRecord));
+    append_records(1, 0, RECORDS_PER_SECTOR + 20);
+
+    flash_shim_set_program_budget(budget);
+    raw_log_end();
+    flash_shim_set_program_budget(FLASH_SHIM_UNLIMITED);
+
+    start(false);
+    CHECK_SESSION(1, RECORDS_PER_SECTOR + 20, 0);
+
+    write_session(2, 10);
+    CHECK_SESSION(1, RECORDS_PER_SECTOR + 20, 0);
+    CHECK_SESSION(2, 10, 0);
+    CHECK(flash_shim_get_program_errors() == 0);
+  }
+}
+
+// Reset in the middle of a ride, nothing was sealed
+static void test_recovery() {
+  start(true);
+  raw_log_begin(1, sizeof(struct TestRecord));
+  append_records(1, 0, RECORDS_PER_SECTOR + 5);
+
+  start(false);
+  CHECK_SESSION(1, RECORDS_PER_SECTOR + 5, 0);
+
+  write_session(2, 5);
+  CHECK_SESSION(1, RECORDS_PER_SECTOR + 5, 0);
+  CHECK_SESSION(2, 5, 0);
+  CHECK(flash_shim_get_program_errors() == 0);
+}
+
+// A session that was never ended keeps its sector, the next one starts on its own sector
+static void test_begin_without_end() {
+  start(true);
+  raw_log_begin(1, sizeof(struct TestRecord));
+  append_records(1, 0, 30);
+  write_session(2, 30);
+
+  CHECK_SESSION(1, 30, 0);
+  CHECK_SESSION(2, 30, 0);
+
+  struct RawLogSectorHeader header;
+  memcpy(&header, flash_shim_get_data(), sizeof(header));
+  CHECK(header.session == 1 && header.length == 30 * sizeof(struct TestRecord));
+  CHECK(flash_shim_get_program_errors() == 0);
+}
+
+int main() {
+  test_sessions();
+  test_wraparound();
+  test_torn_seal();
+  test_recovery();
+  test_begin_without_end();
+
+  CHECK_RESULT();
+}
@@ -0,0 +1,94 @@
+#include "check.h"
+#include "track_simplify.h"
+#include <math.h>
+
+static uint8_t count_kept(const bool *keep, uint8_t count) {
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    kept += keep[i];
+  }
+  return kept;
+}
+
+static void test_single_point() {
+  struct TrackSimplifyPoint points[1] = {{5, 5}};
+  bool keep[1] = {false};
+
+  CHECK(track_simplify(points, 1, 3.0f, keep) == 0);
+  CHECK(keep[0]);
+}
+
+// Points within the tolerance of a straight line collapse to its ends, the deviation is the largest offset
+static void test_straight_line() {
+  struct TrackSimplifyPoint points[TRACK_SIMPLIFY_MAX_POINTS];
+  bool keep[TRACK_SIMPLIFY_MAX_POINTS];
+
+  for (uint8_t i = 0; i < TRACK_SIMPLIFY_MAX_POINTS; i++) {
+    points[i].x = i * 10.0f;
+    points[i].y = i % 2 == 0 ? 0 : 1.5f;
+  }
+
+  float deviation = track_simplify(points, TRACK_SIMPLIFY_MAX_POINTS, 3.0f, keep);
+
+  CHECK(keep[0]);
+  CHECK(keep[TRACK_SIMPLIFY_MAX_POINTS - 1]);
+  CHECK(count_kept(keep, TRACK_SIMPLIFY_MAX_POINTS) == 2);
+  CHECK(deviation > 1.0f && deviation <= 1.5f);
+}
+
+// A right angle keeps its corner and nothing else
+static void test_corner() {
+  struct TrackSimplifyPoint points[11];
+  bool keep[11];
+
+  for (uint8_t i = 0; i <= 5; i++) {
+    points[i].x = i * 10.0f;
+    points[i].y = 0;
+  }
+  for (uint8_t i = 6; i <= 10; i++) {
+    points[i].x = 50;
+    points[i].y = (i - 5) * 10.0f;
+  }
+
+  float deviation = track_simplify(points, 11, 3.0f, keep);
+
+  CHECK(keep[0] && keep[5] && keep[10]);
+  CHECK(count_kept(keep, 11) == 3);
+  CHECK(deviation < 0.001f);
+}
+
+// Every kept point lies on the original track and every dropped one stays within the tolerance
+static void test_zigzag() {
+  struct TrackSimplifyPoint points[TRACK_SIMPLIFY_MAX_POINTS];
+  bool keep[TRACK_SIMPLIFY_MAX_POINTS];
+
+  for (uint8_t i = 0; i < TRACK_SIMPLIFY_MAX_POINTS; i++) {
+    points[i].x = i * 5.0f;
+    points[i].y = 20.0f * sinf(i * 0.3f);
+  }
+
+  float deviation = track_simplify(points, TRACK_SIMPLIFY_MAX_POINTS, 3.0f, keep);
+  uint8_t kept = count_kept(keep, TRACK_SIMPLIFY_MAX_POINTS);
+
+  CHECK(kept > 2 && kept < TRACK_SIMPLIFY_MAX_POINTS);
+  CHECK(deviation <= 3.0f);
+}
+
+static void test_duplicate_ends() {
+  struct TrackSimplifyPoint points[3] = {{0, 0}, {4, 0}, {0, 0}};
+  bool keep[3];
+
+  track_simplify(points, 3, 3.0f, keep);
+
+  CHECK(keep[0] && keep[1] && keep[2]);
+}
+
+int main() {
+  test_single_point();
+  test_straight_line();
+  test_corner();
+  test_zigzag();
+  test_duplicate_ends();
+
+  CHECK_RESULT();
+}